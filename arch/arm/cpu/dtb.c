@@ -47,7 +47,7 @@ static int of_arm_init(void)
 		return 0;
 	}
 
-	root = of_unflatten_dtb(fdt);
+	root = of_unflatten_dtb_const(fdt);
 	if (!IS_ERR(root)) {
 		of_set_root_node(root);
 		of_fix_tree(root);
@@ -94,6 +94,12 @@ int swu_check_img(const char *ifn, const char *ofn);
 
 int swu_check_buf_img(struct bbu_data *data, const char *ifn,  const char *ofn);
 
+int swu_check_buf(const char *ifn, const void *buf, size_t len);
+
+int swu_manifest_load(const char *path);
+
+void swu_manifest_free(void);
+
 #else
 static inline int swu_register_dmo_handlers(void)
 {
@@ -104,6 +110,20 @@ static inline int swu_check_img(const char *ifn, const char *ofn)
 {
 	return -ENOSYS;
 }
+
+static inline int swu_check_buf(const char *ifn, const void *buf, size_t len)
+{
+	return -ENOSYS;
+}
+
+static inline int swu_manifest_load(const char *path)
+{
+	return -ENOSYS;
+}
+
+static inline void swu_manifest_free(void)
+{
+}
 #endif
 
 #endif
@@ -38,6 +38,8 @@ static inline void *dma_alloc_coherent(size_t len, dma_addr_t *handle)
 #endif
 
 #if (DCACHE_SIZE != 0)
+#define DMA_ALIGNMENT	DCACHE_LINE_SIZE
+
 #define dma_alloc dma_alloc
 static inline void *dma_alloc(size_t size)
 {
@@ -41,7 +41,7 @@ static int of_sandbox_init(void)
 	int ret;
 
 	if (dtb) {
-		root = of_unflatten_dtb(dtb);
+		root = of_unflatten_dtb_const(dtb);
 	} else {
 		root = of_new_node(NULL, NULL);
 
@@ -0,0 +1,56 @@
+/*
+ * bootchart.c - show the boot timeline
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include <common.h>
+#include <command.h>
+#include <getopt.h>
+#include <bootchart.h>
+
+static int do_bootchart(int argc, char *argv[])
+{
+	int opt;
+	bool sort = false;
+	unsigned int threshold_us = 0;
+
+	while ((opt = getopt(argc, argv, "st:")) > 0) {
+		switch (opt) {
+		case 's':
+			sort = true;
+			break;
+		case 't':
+			threshold_us = simple_strtoul(optarg, NULL, 0);
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	bootchart_print(threshold_us, sort);
+
+	return 0;
+}
+
+BAREBOX_CMD_HELP_START(bootchart)
+BAREBOX_CMD_HELP_TEXT("Show how long the initcalls, driver probes and boot phases took.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT ("-s", "sort by duration, longest first")
+BAREBOX_CMD_HELP_OPT ("-t USEC", "only show entries which took at least USEC microseconds")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(bootchart)
+	.cmd		= do_bootchart,
+	BAREBOX_CMD_DESC("show boot timeline")
+	BAREBOX_CMD_OPTS("[-st]")
+	BAREBOX_CMD_GROUP(CMD_GRP_INFO)
+	BAREBOX_CMD_HELP(cmd_bootchart_help)
+BAREBOX_CMD_END
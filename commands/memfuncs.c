@@ -0,0 +1,282 @@
+/*
+ * memfuncs.c - test and benchmark memcpy(), memmove() and memset()
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * The word-wise string functions are checked against bytewise reference
+ * implementations for all combinations of misaligned start addresses,
+ * odd lengths and overlapping areas. The buffers are larger than the
+ * areas touched, so writes behind the end of an area are detected as well.
+ */
+
+#include <common.h>
+#include <command.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <clock.h>
+#include <linux/sizes.h>
+#include <linux/math64.h>
+#include <linux/time.h>
+
+#define MF_ALIGN	16	/* offsets tested, more than a word */
+#define MF_AREA		512	/* largest area tested */
+#define MF_BUF		(MF_AREA + 4 * MF_ALIGN)
+#define MF_GUARD	0xa5
+
+/*
+ * The references work through volatile pointers so that the compiler
+ * can't turn them into calls of the functions they are checked against.
+ */
+static void ref_copy(void *dest, const void *src, size_t count)
+{
+	volatile unsigned char *d = dest;
+	const volatile unsigned char *s = src;
+
+	if (d <= s) {
+		while (count--)
+			*d++ = *s++;
+	} else {
+		while (count--)
+			d[count] = s[count];
+	}
+}
+
+static void ref_set(void *s, int c, size_t count)
+{
+	volatile unsigned char *p = s;
+
+	while (count--)
+		*p++ = c;
+}
+
+static void mf_fill(unsigned char *buf, size_t len, unsigned int seed)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = seed >> 16;
+	}
+}
+
+static const size_t mf_lens[] = {
+	0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 23, 31, 32, 33, 47, 63, 64, 65,
+	95, 127, 128, 129, 255, 256, 257, 383, 511, 512,
+};
+
+static int mf_check(const char *func, const unsigned char *buf,
+		    const unsigned char *ref, size_t len, int doff, int soff,
+		    size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (buf[i] == ref[i])
+			continue;
+
+		printf("%s(dst + %d, src + %d, %zu): byte %zu is 0x%02x, expected 0x%02x\n",
+		       func, doff, soff, count, i, buf[i], ref[i]);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int mf_test_memcpy(unsigned char *src, unsigned char *buf,
+			  unsigned char *ref)
+{
+	int soff, doff, i, errors = 0;
+
+	mf_fill(src, MF_BUF, 1);
+
+	for (soff = 0; soff < MF_ALIGN; soff++) {
+		for (doff = 0; doff < MF_ALIGN; doff++) {
+			for (i = 0; i < ARRAY_SIZE(mf_lens); i++) {
+				size_t n = mf_lens[i];
+
+				memset(buf, MF_GUARD, MF_BUF);
+				memset(ref, MF_GUARD, MF_BUF);
+
+				memcpy(buf + MF_ALIGN + doff, src + soff, n);
+				ref_copy(ref + MF_ALIGN + doff, src + soff, n);
+
+				errors += mf_check("memcpy", buf, ref, MF_BUF,
+						   doff, soff, n);
+			}
+		}
+	}
+
+	return errors;
+}
+
+/*
+ * Move within a single buffer. The offsets span more than a word in both
+ * directions, so the areas overlap with every distance.
+ */
+static int mf_test_memmove(unsigned char *buf, unsigned char *ref)
+{
+	int soff, doff, i, errors = 0;
+
+	for (soff = 0; soff < 2 * MF_ALIGN; soff++) {
+		for (doff = 0; doff < 2 * MF_ALIGN; doff++) {
+			for (i = 0; i < ARRAY_SIZE(mf_lens); i++) {
+				size_t n = mf_lens[i];
+
+				mf_fill(buf, MF_BUF, soff + doff);
+				mf_fill(ref, MF_BUF, soff + doff);
+
+				memmove(buf + MF_ALIGN + doff,
+					buf + MF_ALIGN + soff, n);
+				ref_copy(ref + MF_ALIGN + doff,
+					 ref + MF_ALIGN + soff, n);
+
+				errors += mf_check("memmove", buf, ref, MF_BUF,
+						   doff, soff, n);
+			}
+		}
+	}
+
+	return errors;
+}
+
+static int mf_test_memset(unsigned char *buf, unsigned char *ref)
+{
+	static const int vals[] = { 0x00, 0xff, 0x5a, 0x1ff };
+	int doff, i, v, errors = 0;
+
+	for (v = 0; v < ARRAY_SIZE(vals); v++) {
+		for (doff = 0; doff < MF_ALIGN; doff++) {
+			for (i = 0; i < ARRAY_SIZE(mf_lens); i++) {
+				size_t n = mf_lens[i];
+
+				mf_fill(buf, MF_BUF, doff);
+				mf_fill(ref, MF_BUF, doff);
+
+				memset(buf + MF_ALIGN + doff, vals[v], n);
+				ref_set(ref + MF_ALIGN + doff, vals[v], n);
+
+				errors += mf_check("memset", buf, ref, MF_BUF,
+						   doff, vals[v], n);
+			}
+		}
+	}
+
+	return errors;
+}
+
+static void mf_report(const char *name, size_t size, int loops, uint64_t ns)
+{
+	uint64_t rate = div64_u64((uint64_t)size * loops * NSEC_PER_SEC,
+				  ns ? ns : 1);
+
+	printf("%-28s %6llu MiB/s\n", name, rate >> 20);
+}
+
+#define MF_BENCH(name, size, loops, op)					\
+	do {								\
+		uint64_t __start = get_time_ns();			\
+		int __i;						\
+									\
+		for (__i = 0; __i < (loops); __i++)			\
+			op;						\
+		mf_report(name, size, loops, get_time_ns() - __start);	\
+	} while (0)
+
+static void mf_bench(size_t size, int loops)
+{
+	unsigned char *src, *dst;
+
+	/* one extra word for the misaligned runs */
+	src = malloc(size + sizeof(long));
+	dst = malloc(size + sizeof(long));
+	if (!src || !dst) {
+		printf("cannot allocate 2 x %zu bytes\n", size);
+		goto out;
+	}
+
+	memset(src, 0x5a, size + sizeof(long));
+
+	MF_BENCH("memcpy aligned", size, loops, memcpy(dst, src, size));
+	MF_BENCH("memcpy misaligned", size, loops, memcpy(dst, src + 1, size));
+	MF_BENCH("memcpy bytewise", size, loops, ref_copy(dst, src, size));
+	MF_BENCH("memmove overlapping down", size, loops,
+		 memmove(src, src + sizeof(long), size));
+	MF_BENCH("memmove overlapping up", size, loops,
+		 memmove(src + sizeof(long), src, size));
+	MF_BENCH("memset", size, loops, memset(dst, 0, size));
+	MF_BENCH("memset bytewise", size, loops, ref_set(dst, 0, size));
+out:
+	free(src);
+	free(dst);
+}
+
+static int do_memfuncs(int argc, char *argv[])
+{
+	unsigned char *src, *buf, *ref;
+	size_t size = SZ_1M;
+	int opt, loops = 16, bench = 1, errors;
+
+	while ((opt = getopt(argc, argv, "s:l:t")) > 0) {
+		switch (opt) {
+		case 's':
+			size = strtoul_suffix(optarg, NULL, 0);
+			break;
+		case 'l':
+			loops = simple_strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			bench = 0;
+			break;
+		default:
+			return COMMAND_ERROR_USAGE;
+		}
+	}
+
+	if (!size || loops < 1)
+		return COMMAND_ERROR_USAGE;
+
+	src = xmalloc(MF_BUF);
+	buf = xmalloc(MF_BUF);
+	ref = xmalloc(MF_BUF);
+
+	errors = mf_test_memcpy(src, buf, ref);
+	errors += mf_test_memmove(buf, ref);
+	errors += mf_test_memset(buf, ref);
+
+	free(ref);
+	free(buf);
+	free(src);
+
+	printf("memcpy, memmove, memset: %s\n", errors ? "FAILED" : "ok");
+
+	if (bench)
+		mf_bench(size, loops);
+
+	return errors ? COMMAND_ERROR : COMMAND_SUCCESS;
+}
+
+BAREBOX_CMD_HELP_START(memfuncs)
+BAREBOX_CMD_HELP_TEXT("Check memcpy(), memmove() and memset() against bytewise versions")
+BAREBOX_CMD_HELP_TEXT("for misaligned addresses, odd lengths and overlapping areas, then")
+BAREBOX_CMD_HELP_TEXT("measure their throughput.")
+BAREBOX_CMD_HELP_TEXT("")
+BAREBOX_CMD_HELP_TEXT("Options:")
+BAREBOX_CMD_HELP_OPT("-s SIZE", "size of the benchmark buffers (default 1M)")
+BAREBOX_CMD_HELP_OPT("-l LOOPS", "number of runs per benchmark (default 16)")
+BAREBOX_CMD_HELP_OPT("-t", "only test, don't benchmark")
+BAREBOX_CMD_HELP_END
+
+BAREBOX_CMD_START(memfuncs)
+	.cmd		= do_memfuncs,
+	BAREBOX_CMD_DESC("test and benchmark the memory functions")
+	BAREBOX_CMD_OPTS("[-slt]")
+	BAREBOX_CMD_GROUP(CMD_GRP_MEM)
+	BAREBOX_CMD_HELP(cmd_memfuncs_help)
+BAREBOX_CMD_END
@@ -20,11 +20,20 @@
 #include <command.h>
 #include <complete.h>
 #include <malloc.h>
+#include <param.h>
+#include <mem_cache.h>
 
 static int do_meminfo(int argc, char *argv[])
 {
 	malloc_stats();
 
+	printf("\n");
+	command_print_lookup_stats();
+	param_print_lookup_stats();
+
+	printf("\n");
+	mem_cache_print_stats();
+
 	return 0;
 }
 
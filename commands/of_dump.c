@@ -52,7 +52,7 @@ static int do_of_dump(int argc, char *argv[])
 	const char *nodename;
 	int names_only = 0;
 
-	while ((opt = getopt(argc, argv, "Ff:n")) > 0) {
+	while ((opt = getopt(argc, argv, "Ff:ns")) > 0) {
 		switch (opt) {
 		case 'f':
 			dtbfile = optarg;
@@ -63,6 +63,9 @@ static int do_of_dump(int argc, char *argv[])
 		case 'n':
 			names_only = 1;
 			break;
+		case 's':
+			of_print_lookup_stats();
+			return 0;
 		default:
 			return COMMAND_ERROR_USAGE;
 		}
@@ -142,12 +145,13 @@ BAREBOX_CMD_HELP_TEXT("Options:")
 BAREBOX_CMD_HELP_OPT  ("-f dtb",  "work on dtb instead of internal devicetree\n")
 BAREBOX_CMD_HELP_OPT  ("-F",  "return fixed devicetree\n")
 BAREBOX_CMD_HELP_OPT  ("-n",  "Print node names only, no properties\n")
+BAREBOX_CMD_HELP_OPT  ("-s",  "Print devicetree lookup statistics\n")
 BAREBOX_CMD_HELP_END
 
 BAREBOX_CMD_START(of_dump)
 	.cmd		= do_of_dump,
 	BAREBOX_CMD_DESC("dump devicetree nodes")
-	BAREBOX_CMD_OPTS("[-fFn] [NODE]")
+	BAREBOX_CMD_OPTS("[-fFns] [NODE]")
 	BAREBOX_CMD_GROUP(CMD_GRP_MISC)
 	BAREBOX_CMD_COMPLETE(devicetree_file_complete)
 	BAREBOX_CMD_HELP(cmd_of_dump_help)
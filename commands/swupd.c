@@ -45,6 +45,7 @@
 #define USB_MNT		"/mnt/disk"
 #define INIFILE		USB_MNT"/inifile"
 #define TOUCHFILE	USB_MNT"/maxtouch.txt"
+#define MANIFEST	USB_MNT"/manifest"
 #define DISPLAYID	"FW_Rev"
 #define SWU_CONF_VER	"0.2"
 #define BUFSIZE		1024
@@ -121,8 +122,6 @@ static int swu_update_bb(const char *bb_dev)
 	snprintf(target_dev, sizeof(target_dev)-1, DEV"%s.barebox", bb_dev);
 
 	snprintf(full_nm, sizeof(full_nm)-1, USB_MNT"/%s", img);
-	if (swu_check_img(full_nm, full_nm))
-		return -EINVAL;
 
 	if (!strcmp(bb_dev, "m25p0"))
 		data.handler_name = spiflash_dev;
@@ -138,6 +137,10 @@ static int swu_update_bb(const char *bb_dev)
 		swu_log("Barebox image is not found %d\n", ret);
 		return -errno;
 	}
+	if (swu_check_buf(full_nm, data.image, data.len)) {
+		free(data.image);
+		return -EINVAL;
+	}
 	ret = barebox_update(&data);
 	if (!ret)
 		/* Take partition table into account */
@@ -252,8 +255,13 @@ static int swu_update_script(void)
 	if (!img)
 		return -EINVAL;
 
-	swu_log("Script executing...\n");
 	sprintf(full_nm,USB_MNT"/%s",img);
+	if (swu_check_img(full_nm, full_nm)) {
+		swu_log("ERROR: script signature check failed.\n");
+		return -EPERM;
+	}
+
+	swu_log("Script executing...\n");
 	ret = run_command(full_nm);
 	swu_log("update via script status: %d\n", ret);
 
@@ -706,6 +714,13 @@ static int do_swu(int argc, char *argv[])
 		goto out;
 	}
 
+	ret = swu_manifest_load(MANIFEST);
+	if (ret && ret != -ENOENT) {
+		swu_log("ERROR: invalid manifest.\n");
+		goto out;
+	}
+	ret = 0;
+
 	if (swu_update_script() == -EINVAL) {//means no scritp found
 
 		flag = 1;
@@ -27,6 +27,7 @@
 #include <malloc.h>
 #include <linux/stat.h>
 #include <image-metadata.h>
+#include <image-sparse.h>
 
 static LIST_HEAD(bbu_image_handlers);
 
@@ -296,6 +297,31 @@ struct bbu_std {
 	enum filetype filetype;
 };
 
+/*
+ * Sparse images and images with a block map are written range by range,
+ * skipping the parts of the image without data. Delta images update the
+ * installed image with the blocks that changed.
+ */
+static int bbu_std_write_mapped(struct bbu_data *data, enum filetype filetype,
+				const char *bmap)
+{
+	int ret;
+
+	ret = bbu_confirm(data);
+	if (ret)
+		return ret;
+
+	if (filetype == filetype_android_sparse)
+		return write_sparse_image(data->imagefile, data->devicefile,
+					  IMAGE_WRITE_ERASE);
+
+	if (filetype == filetype_barebox_delta)
+		return write_delta_image(data->imagefile, data->devicefile, 0);
+
+	return write_bmap_image(data->imagefile, bmap, data->devicefile,
+				IMAGE_WRITE_ERASE);
+}
+
 static int bbu_std_file_handler(struct bbu_handler *handler,
 					struct bbu_data *data)
 {
@@ -306,6 +332,20 @@ static int bbu_std_file_handler(struct bbu_handler *handler,
 	unsigned oflags = O_WRONLY;
 
 	filetype = file_detect_type(data->image, data->len);
+
+	/* the type of the image inside is only known once it is unpacked */
+	if (IS_ENABLED(CONFIG_IMAGE_SPARSE) && data->imagefile &&
+	    (filetype == filetype_android_sparse ||
+	     (IS_ENABLED(CONFIG_IMAGE_DELTA) &&
+	      filetype == filetype_barebox_delta))) {
+		if (!bbu_force(data, "cannot check the image type inside %s. Expected: %s",
+				file_type_to_string(filetype),
+				file_type_to_string(std->filetype)))
+			return -EINVAL;
+
+		return bbu_std_write_mapped(data, filetype, NULL);
+	}
+
 	if (filetype != std->filetype) {
 		if (!bbu_force(data, "incorrect image type. Expected: %s, got %s",
 				file_type_to_string(std->filetype),
@@ -313,6 +353,16 @@ static int bbu_std_file_handler(struct bbu_handler *handler,
 			return -EINVAL;
 	}
 
+	if (IS_ENABLED(CONFIG_IMAGE_SPARSE) && data->imagefile) {
+		char *bmap = image_find_bmap(data->imagefile);
+
+		if (bmap) {
+			ret = bbu_std_write_mapped(data, filetype, bmap);
+			free(bmap);
+			return ret;
+		}
+	}
+
 	ret = stat(data->devicefile, &s);
 	if (ret) {
 		oflags |= O_CREAT;
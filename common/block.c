@@ -38,6 +38,9 @@ struct chunk {
 
 #define BUFSIZE (PAGE_SIZE * 16)
 
+/* default limit of direct requests, in chunks */
+#define DIRECT_CHUNKS	16
+
 /*
  * Write all dirty chunks back to the device
  */
@@ -157,6 +160,54 @@ static int block_cache(struct block_device *blk, int block)
 	return 0;
 }
 
+/*
+ * Runs of whole chunks are transferred between the device and the buffer
+ * of the caller in a single request instead of chunk by chunk through the
+ * cache. Return the number of blocks starting at block which can be
+ * transferred this way, 0 if the cache must be used. A request is never
+ * larger than max_blocks, many drivers can't split larger ones.
+ */
+static int block_direct_blocks(struct block_device *blk, const void *buf,
+		int block, int blocks)
+{
+	if (!IS_ALIGNED((unsigned long)buf, DMA_ALIGNMENT) ||
+			(block & blk->blkmask))
+		return 0;
+
+	blocks = min(blocks, blk->num_blocks - block);
+	blocks = min(blocks, blk->max_blocks);
+
+	return blocks & ~blk->blkmask;
+}
+
+/*
+ * Write back the dirty chunks of a range which is read directly
+ */
+static int block_flush_range(struct block_device *blk, int block, int num)
+{
+	struct chunk *chunk;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_BLOCK_WRITE))
+		return 0;
+
+	list_for_each_entry(chunk, &blk->buffered_blocks, list) {
+		if (!chunk->dirty || chunk->block_start < block ||
+				chunk->block_start >= block + num)
+			continue;
+
+		ret = blk->ops->write(blk, chunk->data, chunk->block_start,
+				min(blk->rdbufsize,
+				    blk->num_blocks - chunk->block_start));
+		if (ret)
+			return ret;
+
+		chunk->dirty = 0;
+	}
+
+	return 0;
+}
+
 /*
  * Get the data for a block, either from the cache or from
  * the device.
@@ -211,8 +262,25 @@ static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 	blocks = count >> blk->blockbits;
 
 	while (blocks) {
-		void *iobuf = block_get(blk, block);
+		void *iobuf;
+		int ret, now;
+
+		now = block_direct_blocks(blk, buf, block, blocks);
+		if (now) {
+			ret = block_flush_range(blk, block, now);
+			if (!ret)
+				ret = blk->ops->read(blk, buf, block, now);
+			if (ret)
+				return ret;
+
+			buf += now << blk->blockbits;
+			blocks -= now;
+			block += now;
+			count -= (size_t)now << blk->blockbits;
+			continue;
+		}
 
+		iobuf = block_get(blk, block);
 		if (IS_ERR(iobuf))
 			return PTR_ERR(iobuf);
 
@@ -237,6 +305,24 @@ static ssize_t block_op_read(struct cdev *cdev, void *buf, size_t count,
 
 #ifdef CONFIG_BLOCK_WRITE
 
+/*
+ * Drop the cached chunks of a range which is overwritten directly
+ */
+static void block_invalidate_range(struct block_device *blk, int block,
+		int num)
+{
+	struct chunk *chunk, *tmp;
+
+	list_for_each_entry_safe(chunk, tmp, &blk->buffered_blocks, list) {
+		if (chunk->block_start < block ||
+				chunk->block_start >= block + num)
+			continue;
+
+		chunk->dirty = 0;
+		list_move_tail(&chunk->list, &blk->idle_blocks);
+	}
+}
+
 /*
  * Put data into a block. This only overwrites the data in the
  * cache and marks the corresponding chunk as dirty.
@@ -292,6 +378,22 @@ static ssize_t block_op_write(struct cdev *cdev, const void *buf, size_t count,
 	blocks = count >> blk->blockbits;
 
 	while (blocks) {
+		int now = block_direct_blocks(blk, buf, block, blocks);
+
+		if (now) {
+			block_invalidate_range(blk, block, now);
+
+			ret = blk->ops->write(blk, buf, block, now);
+			if (ret)
+				return ret;
+
+			buf += now << blk->blockbits;
+			blocks -= now;
+			block += now;
+			count -= (size_t)now << blk->blockbits;
+			continue;
+		}
+
 		ret = block_put(blk, buf, block);
 		if (ret)
 			return ret;
@@ -357,6 +459,8 @@ int blockdevice_register(struct block_device *blk)
 	INIT_LIST_HEAD(&blk->buffered_blocks);
 	INIT_LIST_HEAD(&blk->idle_blocks);
 	blk->blkmask = blk->rdbufsize - 1;
+	if (!blk->max_blocks)
+		blk->max_blocks = DIRECT_CHUNKS * blk->rdbufsize;
 
 	debug("%s: rdbufsize: %d blockbits: %d blkmask: 0x%08x\n", __func__, blk->rdbufsize, blk->blockbits,
 			blk->blkmask);
@@ -0,0 +1,252 @@
+/*
+ * bootchart.c - record where the time is spent during boot
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include <common.h>
+#include <bootchart.h>
+#include <malloc.h>
+#include <init.h>
+#include <qsort.h>
+#include <globalvar.h>
+#include <magicvar.h>
+#include <of.h>
+#include <asm-generic/div64.h>
+
+struct bootchart_entry {
+	struct list_head list;
+	enum bootchart_type type;
+	char *name;
+	const void *fn;
+	int result;
+	uint64_t start;
+	uint64_t duration;
+};
+
+/* bounds the timeline if the boot never reaches the shell */
+#define BOOTCHART_MAX_ENTRIES	4096
+
+static LIST_HEAD(bootchart_entries);
+static unsigned int bootchart_num_entries;
+static bool bootchart_stopped;
+
+static int bootchart_oftree;
+static int bootchart_oftree_threshold_us = 1000;
+
+static const char *bootchart_type_name[] = {
+	[BOOTCHART_PHASE] = "phase",
+	[BOOTCHART_INITCALL] = "initcall",
+	[BOOTCHART_PROBE] = "probe",
+	[BOOTCHART_SCRIPT] = "script",
+};
+
+/**
+ * bootchart_record - add an entry to the boot timeline
+ * @type: what is being recorded
+ * @name: name of the entry, copied. May be NULL when @fn is given
+ * @fn: function the entry is named after if @name is NULL
+ * @result: return value of the recorded function
+ * @start: start time as returned by bootchart_start()
+ *
+ * The duration of the entry is the time from @start until now. Nothing is
+ * recorded anymore after bootchart_stop() or once BOOTCHART_MAX_ENTRIES
+ * entries are recorded.
+ */
+void bootchart_record(enum bootchart_type type, const char *name,
+		      const void *fn, int result, uint64_t start)
+{
+	struct bootchart_entry *e;
+	uint64_t now = get_time_ns();
+
+	if (bootchart_stopped || bootchart_num_entries >= BOOTCHART_MAX_ENTRIES)
+		return;
+
+	e = malloc(sizeof(*e));
+	if (!e)
+		return;
+
+	e->type = type;
+	e->name = name ? strdup(name) : NULL;
+	e->fn = fn;
+	e->result = result;
+	/*
+	 * Time before the final clocksource was registered is not
+	 * meaningful, count from its registration instead.
+	 */
+	e->start = max(start, time_beginning);
+	e->duration = now - e->start;
+
+	list_add_tail(&e->list, &bootchart_entries);
+	bootchart_num_entries++;
+}
+
+/**
+ * bootchart_stop - end the boot timeline
+ *
+ * Called once the boot is done, at the latest when the interactive shell
+ * starts. Scripts and probes run from the shell afterwards are not part of
+ * the boot and would grow the timeline without bound.
+ */
+void bootchart_stop(void)
+{
+	bootchart_stopped = true;
+}
+
+static unsigned long ns_to_us(uint64_t ns)
+{
+	do_div(ns, 1000);
+
+	return ns;
+}
+
+static unsigned long bootchart_start_us(struct bootchart_entry *e)
+{
+	if (e->start < time_beginning)
+		return 0;
+
+	return ns_to_us(e->start - time_beginning);
+}
+
+static char *bootchart_name(struct bootchart_entry *e)
+{
+	if (e->name)
+		return xstrdup(e->name);
+
+	return basprintf("%pS", e->fn);
+}
+
+static int bootchart_compare(const void *a, const void *b)
+{
+	const struct bootchart_entry *ea = *(const struct bootchart_entry **)a;
+	const struct bootchart_entry *eb = *(const struct bootchart_entry **)b;
+
+	if (ea->duration == eb->duration)
+		return 0;
+
+	return ea->duration < eb->duration ? 1 : -1;
+}
+
+/**
+ * bootchart_print - print the boot timeline
+ * @threshold_us: skip entries which took less than this
+ * @sort: sort by duration, longest first, instead of chronologically
+ */
+void bootchart_print(unsigned int threshold_us, bool sort)
+{
+	struct bootchart_entry *e, **entries;
+	unsigned long total[ARRAY_SIZE(bootchart_type_name)] = {};
+	int i, n = 0;
+
+	entries = xmalloc(bootchart_num_entries * sizeof(*entries));
+
+	list_for_each_entry(e, &bootchart_entries, list) {
+		total[e->type] += ns_to_us(e->duration);
+		if (ns_to_us(e->duration) >= threshold_us)
+			entries[n++] = e;
+	}
+
+	if (sort)
+		qsort(entries, n, sizeof(*entries), bootchart_compare);
+
+	printf("   start[ms]  duration[ms] type     name\n");
+
+	for (i = 0; i < n; i++) {
+		unsigned long start, duration;
+		char *name;
+
+		e = entries[i];
+		start = bootchart_start_us(e);
+		duration = ns_to_us(e->duration);
+		name = bootchart_name(e);
+
+		printf("%8lu.%03lu %9lu.%03lu %-8s %s", start / 1000,
+		       start % 1000, duration / 1000, duration % 1000,
+		       bootchart_type_name[e->type], name);
+		if (e->result)
+			printf(" (%s)", strerror(-e->result));
+		printf("\n");
+
+		free(name);
+	}
+
+	printf("total: initcalls %lu ms, probes %lu ms\n",
+	       total[BOOTCHART_INITCALL] / 1000, total[BOOTCHART_PROBE] / 1000);
+
+	free(entries);
+}
+
+/*
+ * Pass the timeline to the kernel as a string list of
+ * "<start_us> <duration_us> <type> <name>" entries
+ */
+static int bootchart_of_fixup(struct device_node *root, void *unused)
+{
+	struct bootchart_entry *e;
+	struct device_node *node;
+	char *buf = NULL;
+	size_t len = 0;
+	int ret;
+
+	if (!bootchart_oftree)
+		return 0;
+
+	list_for_each_entry(e, &bootchart_entries, list) {
+		unsigned long duration = ns_to_us(e->duration);
+		char *name, *str;
+		size_t slen;
+
+		if (duration < bootchart_oftree_threshold_us &&
+		    e->type != BOOTCHART_PHASE)
+			continue;
+
+		name = bootchart_name(e);
+		str = basprintf("%lu %lu %s %s", bootchart_start_us(e),
+				duration, bootchart_type_name[e->type], name);
+		free(name);
+
+		slen = strlen(str) + 1;
+		buf = xrealloc(buf, len + slen);
+		memcpy(buf + len, str, slen);
+		len += slen;
+
+		free(str);
+	}
+
+	if (!len)
+		return 0;
+
+	node = of_create_node(root, "/chosen");
+	if (!node) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = of_set_property(node, "barebox,bootchart", buf, len, 1);
+out:
+	free(buf);
+
+	return ret;
+}
+
+static int bootchart_init(void)
+{
+	globalvar_add_simple_bool("bootchart.oftree", &bootchart_oftree);
+	globalvar_add_simple_int("bootchart.oftree_threshold_us",
+				 &bootchart_oftree_threshold_us, "%u");
+
+	return of_register_fixup(bootchart_of_fixup, NULL);
+}
+late_initcall(bootchart_init);
+
+BAREBOX_MAGICVAR_NAMED(global_bootchart_oftree, global.bootchart.oftree,
+		       "If true, pass the boot timeline to the kernel in /chosen/barebox,bootchart");
+BAREBOX_MAGICVAR_NAMED(global_bootchart_oftree_threshold_us,
+		       global.bootchart.oftree_threshold_us,
+		       "Only pass entries to the kernel which took at least this many microseconds");
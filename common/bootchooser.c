@@ -39,6 +39,7 @@
 
 #include <linux/kernel.h>
 #include <linux/list.h>
+#include <linux/list_sort.h>
 #include <linux/err.h>
 
 #define BOOTCHOOSER_PREFIX "global.bootchooser"
@@ -61,8 +62,22 @@ struct bootchooser {
 
 	int verbose;
 	int dryrun;
+
+	bool sorted;
+	bool in_use;
+
+	/* parameter generations the targets have been read or saved at */
+	unsigned int global_generation;
+	unsigned int nv_generation;
+	unsigned int state_generation;
 };
 
+/*
+ * The last bootchooser put, reused by bootchooser_get() as long as none of
+ * the variables it has been created from changed.
+ */
+static struct bootchooser *bootchooser_cache;
+
 struct bootchooser_target {
 	struct bootchooser *bootchooser;
 	struct list_head list;
@@ -212,15 +227,31 @@ static int getenv_u32(const char *prefix, const char *name, uint32_t *retval)
 	return 0;
 }
 
-static int bootchooser_target_compare(struct list_head *a, struct list_head *b)
+static int bootchooser_target_compare(void *priv, struct list_head *a,
+				      struct list_head *b)
 {
 	struct bootchooser_target *bootchooser_a =
 		list_entry(a, struct bootchooser_target, list);
 	struct bootchooser_target *bootchooser_b =
 		list_entry(b, struct bootchooser_target, list);
 
-	/* order with descending priority */
-	return bootchooser_a->priority >= bootchooser_b->priority ? -1 : 1;
+	/* order with descending priority, then by id */
+	if (bootchooser_a->priority != bootchooser_b->priority)
+		return bootchooser_a->priority > bootchooser_b->priority ? -1 : 1;
+
+	return bootchooser_a->id - bootchooser_b->id;
+}
+
+/*
+ * bootchooser_sort - sort the targets after their priorities changed
+ */
+static void bootchooser_sort(struct bootchooser *bc)
+{
+	if (bc->sorted)
+		return;
+
+	list_sort(NULL, &bc->targets, bootchooser_target_compare);
+	bc->sorted = true;
 }
 
 /**
@@ -238,6 +269,7 @@ static struct bootchooser_target *bootchooser_target_new(struct bootchooser *bc,
 	const char *val;
 	int ret;
 
+	target->bootchooser = bc;
 	target->name = xstrdup(name);
 	target->prefix = basprintf("%s.%s", BOOTCHOOSER_PREFIX, name);
 	target->state_prefix = basprintf("%s.%s", bc->state_prefix, name);
@@ -345,20 +377,56 @@ static void bootchooser_reset_priorities(struct bootchooser *bc)
 		bootchooser_target_set_priority(target, -1);
 }
 
+static void bootchooser_free(struct bootchooser *bc)
+{
+	struct bootchooser_target *target, *tmp;
+
+	list_for_each_entry_safe(target, tmp, &bc->targets, list) {
+		free(target->boot);
+		free(target->prefix);
+		free(target->state_prefix);
+		free(target->name);
+		free(target);
+	}
+
+	free(bc->state_prefix);
+	free(bc);
+}
+
+static void bootchooser_cache_update(struct bootchooser *bc)
+{
+	bc->global_generation = global_device.param_generation;
+	bc->nv_generation = nv_device.param_generation;
+	if (IS_ENABLED(CONFIG_STATE) && bc->state)
+		bc->state_generation = state_get_generation(bc->state);
+}
+
+static bool bootchooser_cache_valid(struct bootchooser *bc)
+{
+	if (bc->global_generation != global_device.param_generation ||
+	    bc->nv_generation != nv_device.param_generation)
+		return false;
+
+	if (IS_ENABLED(CONFIG_STATE) && bc->state &&
+	    bc->state_generation != state_get_generation(bc->state))
+		return false;
+
+	return true;
+}
+
 /**
- * bootchooser_get - get a bootchooser instance
+ * bootchooser_new - create a bootchooser instance
  *
  * This evaluates the different globalvars and eventually state variables,
  * creates a bootchooser instance from it and returns it.
  */
-struct bootchooser *bootchooser_get(void)
+static struct bootchooser *bootchooser_new(void)
 {
 	struct bootchooser *bc;
 	struct bootchooser_target *target;
 	char *targets, *str, *freep = NULL, *delim;
 	int ret = -EINVAL, id = 1;
 	uint32_t last_chosen;
-	static int attempts_resetted;
 
 	bc = xzalloc(sizeof(*bc));
 
@@ -405,8 +473,7 @@ struct bootchooser *bootchooser_get(void)
 		target = bootchooser_target_new(bc, str);
 		if (!IS_ERR(target)) {
 			target->id = id;
-			list_add_sort(&target->list, &bc->targets,
-				      bootchooser_target_compare);
+			list_add_tail(&target->list, &bc->targets);
 		}
 
 		id++;
@@ -424,6 +491,57 @@ struct bootchooser *bootchooser_get(void)
 
 	free(freep);
 
+	ret = getenv_u32(bc->state_prefix, "last_chosen", &last_chosen);
+	if (!ret && last_chosen > 0) {
+		bc->last_chosen = bootchooser_target_by_id(bc, last_chosen);
+		if (!bc->last_chosen)
+			pr_warn("Last booted target with id %d does not exist\n", last_chosen);
+	}
+
+	bootchooser_cache_update(bc);
+
+	return bc;
+
+err:
+	free(freep);
+	free(bc->state_prefix);
+	free(bc);
+
+	return ERR_PTR(ret);
+}
+
+/**
+ * bootchooser_get - get a bootchooser instance
+ *
+ * Returns the bootchooser instance put last if the variables it has been
+ * created from didn't change since, otherwise a new one. The targets are
+ * sorted by priority, the one to boot next first.
+ */
+struct bootchooser *bootchooser_get(void)
+{
+	struct bootchooser *bc = bootchooser_cache;
+	struct bootchooser_target *target;
+	static int attempts_resetted;
+
+	if (bc && (bc->in_use || !bootchooser_cache_valid(bc))) {
+		if (!bc->in_use) {
+			bootchooser_free(bc);
+			bootchooser_cache = NULL;
+		}
+		bc = NULL;
+	}
+
+	if (!bc) {
+		bc = bootchooser_new();
+		if (IS_ERR(bc))
+			return bc;
+
+		if (!bootchooser_cache)
+			bootchooser_cache = bc;
+	}
+
+	bc->in_use = true;
+
 	if (test_bit(RESET_PRIORITIES_ALL_ZERO, &reset_priorities)) {
 		int priority = 0;
 
@@ -455,13 +573,6 @@ struct bootchooser *bootchooser_get(void)
 		}
 	}
 
-	ret = getenv_u32(bc->state_prefix, "last_chosen", &last_chosen);
-	if (!ret && last_chosen > 0) {
-		bc->last_chosen = bootchooser_target_by_id(bc, last_chosen);
-		if (!bc->last_chosen)
-			pr_warn("Last booted target with id %d does not exist\n", last_chosen);
-	}
-
 	if (bc->last_chosen && last_boot_successful)
 		bootchooser_target_set_attempts(bc->last_chosen, -1);
 
@@ -476,13 +587,9 @@ struct bootchooser *bootchooser_get(void)
 
 	}
 
-	return bc;
+	bootchooser_sort(bc);
 
-err:
-	free(freep);
-	free(bc);
-
-	return ERR_PTR(ret);
+	return bc;
 }
 
 /**
@@ -514,7 +621,7 @@ int bootchooser_save(struct bootchooser *bc)
 	}
 
 	if (IS_ENABLED(CONFIG_STATE) && bc->state) {
-		ret = state_save(bc->state);
+		ret = state_save_deferred(bc->state);
 		if (ret) {
 			pr_err("Cannot save state: %s\n", strerror(-ret));
 			return ret;
@@ -534,26 +641,29 @@ int bootchooser_save(struct bootchooser *bc)
  * bootchooser_put - release a bootchooser instance
  * @bc: The bootchooser instance
  *
- * This releases a bootchooser instance and the memory associated with it.
+ * This saves and releases a bootchooser instance. When saving succeeded
+ * the instance is kept for the next bootchooser_get(), otherwise the memory
+ * associated with it is freed.
  */
 int bootchooser_put(struct bootchooser *bc)
 {
-	struct bootchooser_target *target, *tmp;
 	int ret;
 
 	ret = bootchooser_save(bc);
 	if (ret)
 		pr_err("Failed to save bootchooser state: %s\n", strerror(-ret));
 
-	list_for_each_entry_safe(target, tmp, &bc->targets, list) {
-		free(target->boot);
-		free(target->prefix);
-		free(target->state_prefix);
-		free(target->name);
-		free(target);
+	if (bc == bootchooser_cache) {
+		if (!ret) {
+			bootchooser_cache_update(bc);
+			bc->in_use = false;
+			return 0;
+		}
+
+		bootchooser_cache = NULL;
 	}
 
-	free(bc);
+	bootchooser_free(bc);
 
 	return ret;
 }
@@ -568,6 +678,8 @@ void bootchooser_info(struct bootchooser *bc)
 	const char *reason;
 	int count = 0;
 
+	bootchooser_sort(bc);
+
 	printf("Good targets (first will be booted next):\n");
 	list_for_each_entry(target, &bc->targets, list) {
 		if (bootchooser_target_ok(target, NULL)) {
@@ -611,6 +723,8 @@ struct bootchooser_target *bootchooser_get_target(struct bootchooser *bc)
 {
 	struct bootchooser_target *target;
 
+	bootchooser_sort(bc);
+
 	list_for_each_entry(target, &bc->targets, list) {
 		if (bootchooser_target_ok(target, NULL))
 			goto found;
@@ -710,6 +824,8 @@ int bootchooser_target_set_priority(struct bootchooser_target *target, int prior
 	else
 		target->priority = target->default_priority;
 
+	target->bootchooser->sorted = false;
+
 	return 0;
 }
 
@@ -335,7 +335,7 @@ int bootm_load_devicetree(struct image_data *data, unsigned long load_address)
 		return 0;
 
 	if (data->os_fit && data->os_fit->oftree) {
-		data->of_root_node = of_unflatten_dtb(data->os_fit->oftree);
+		data->of_root_node = of_unflatten_dtb_const(data->os_fit->oftree);
 
 		if (IS_ERR(data->of_root_node))
 			data->of_root_node = NULL;
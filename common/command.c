@@ -30,10 +30,26 @@
 #include <init.h>
 #include <complete.h>
 #include <getopt.h>
+#include <poller.h>
 
 LIST_HEAD(command_list);
 EXPORT_SYMBOL(command_list);
 
+/* commands indexed by name, the most recently registered one first */
+#define COMMAND_HASH_SIZE	128
+static struct hlist_head command_hash[COMMAND_HASH_SIZE];
+static unsigned long command_lookups, command_compares;
+
+static unsigned int command_hash_key(const char *name)
+{
+	unsigned int hash = 5381;
+
+	while (*name)
+		hash = hash * 33 + *name++;
+
+	return hash % COMMAND_HASH_SIZE;
+}
+
 void barebox_cmd_usage(struct command *cmdtp)
 {
 	putchar('\n');
@@ -69,6 +85,9 @@ int execute_command(int argc, char **argv)
 
 	getopt_context_store(&gc);
 
+	/* give pending background work a chance to progress */
+	poller_work_run();
+
 	/* Look up command in command table */
 	if ((cmdtp = find_cmd(argv[0]))) {
 		/* OK - call function to do the command */
@@ -102,6 +121,7 @@ int register_command(struct command *cmd)
 	debug("register command %s\n", cmd->name);
 
 	list_add_sort(&cmd->list, &command_list, compare);
+	hlist_add_head(&cmd->hash, &command_hash[command_hash_key(cmd->name)]);
 
 	if (cmd->aliases) {
 		char **aliases = (char**)cmd->aliases;
@@ -132,15 +152,26 @@ EXPORT_SYMBOL(register_command);
 struct command *find_cmd (const char *cmd)
 {
 	struct command *cmdtp;
+	struct hlist_node *n;
+
+	command_lookups++;
 
-	for_each_command(cmdtp)
+	hlist_for_each_entry(cmdtp, n, &command_hash[command_hash_key(cmd)], hash) {
+		command_compares++;
 		if (!strcmp(cmd, cmdtp->name))
 			return cmdtp;
+	}
 
 	return NULL;	/* not found or ambiguous command */
 }
 EXPORT_SYMBOL(find_cmd);
 
+void command_print_lookup_stats(void)
+{
+	printf("command lookups: %lu, name compares: %lu\n",
+	       command_lookups, command_compares);
+}
+
 /*
  * Put all commands into a linked list. Without module support we could use
  * the raw command array, but with module support a list is easier to handle.
@@ -59,6 +59,90 @@ static struct kfifo __console_output_fifo;
 static struct kfifo *console_input_fifo = &__console_input_fifo;
 static struct kfifo *console_output_fifo = &__console_output_fifo;
 
+#define CONSOLE_TX_BUFFER_SIZE	4096
+
+/*
+ * Write out buffered characters. Without wait only as many as the
+ * hardware takes without waiting.
+ */
+static void console_tx_drain(struct console_device *cdev, bool wait)
+{
+	unsigned char c;
+
+	if (!cdev->tx_fifo)
+		return;
+
+	while (kfifo_len(cdev->tx_fifo)) {
+		if (!wait && !cdev->tx_ready(cdev))
+			return;
+
+		kfifo_getc(cdev->tx_fifo, &c);
+		cdev->tx_putc(cdev, c);
+	}
+}
+
+/* putc replacement for consoles with a transmit buffer */
+static void console_tx_putc(struct console_device *cdev, char c)
+{
+	unsigned char old;
+
+	/* buffer full, wait for the hardware to make room */
+	if (kfifo_len(cdev->tx_fifo) == cdev->tx_fifo->size) {
+		kfifo_getc(cdev->tx_fifo, &old);
+		cdev->tx_putc(cdev, old);
+	}
+
+	kfifo_putc(cdev->tx_fifo, c);
+
+	console_tx_drain(cdev, false);
+}
+
+static void console_tx_poll(struct poller_struct *poller)
+{
+	struct console_device *cdev;
+
+	for_each_console(cdev)
+		console_tx_drain(cdev, false);
+}
+
+static struct poller_struct console_tx_poller = {
+	.func = console_tx_poll,
+};
+
+/*
+ * Consoles which can tell whether the hardware takes another character
+ * get a transmit buffer. The buffer is written out from a poller and
+ * whenever more characters are written, so that printing does not wait
+ * for slow serial lines.
+ */
+static void console_tx_init(struct console_device *cdev)
+{
+	if (!IS_ENABLED(CONFIG_CONSOLE_TX_BUFFER) || !cdev->tx_ready ||
+	    !cdev->putc || cdev->puts)
+		return;
+
+	cdev->tx_fifo = kfifo_alloc(CONSOLE_TX_BUFFER_SIZE);
+	if (!cdev->tx_fifo)
+		return;
+
+	cdev->tx_putc = cdev->putc;
+	cdev->putc = console_tx_putc;
+
+	if (!console_tx_poller.registered)
+		poller_register(&console_tx_poller);
+}
+
+static void console_tx_exit(struct console_device *cdev)
+{
+	if (!cdev->tx_fifo)
+		return;
+
+	console_tx_drain(cdev, true);
+	kfifo_free(cdev->tx_fifo);
+	cdev->tx_fifo = NULL;
+	cdev->putc = cdev->tx_putc;
+}
+
 int console_open(struct console_device *cdev)
 {
 	int ret;
@@ -101,8 +185,11 @@ int console_set_active(struct console_device *cdev, unsigned flag)
 	if (!cdev->putc)
 		flag &= ~(CONSOLE_STDOUT | CONSOLE_STDERR);
 
-	if (!flag && cdev->f_active && cdev->flush)
-		cdev->flush(cdev);
+	if (!flag && cdev->f_active) {
+		console_tx_drain(cdev, true);
+		if (cdev->flush)
+			cdev->flush(cdev);
+	}
 
 	if (flag == cdev->f_active)
 		return 0;
@@ -194,6 +281,7 @@ int console_set_baudrate(struct console_device *cdev, unsigned baudrate)
 	if (cdev->f_active) {
 		printf("## Switch baudrate on console %s to %d bps and press ENTER ...\n",
 			dev_name(&cdev->class_dev), baudrate);
+		console_tx_drain(cdev, true);
 		mdelay(50);
 	}
 
@@ -290,6 +378,8 @@ static int fops_flush(struct cdev *dev)
 {
 	struct console_device *priv = dev->priv;
 
+	console_tx_drain(priv, true);
+
 	if (priv->flush)
 		priv->flush(priv);
 
@@ -335,6 +425,8 @@ int console_register(struct console_device *newcdev)
 			NULL, &newcdev->baudrate_param, "%u", newcdev);
 	}
 
+	console_tx_init(newcdev);
+
 	if (newcdev->putc && !newcdev->puts)
 		newcdev->puts = __console_puts;
 
@@ -390,6 +482,8 @@ int console_unregister(struct console_device *cdev)
 
 	devfs_remove(&cdev->devfs);
 
+	console_tx_exit(cdev);
+
 	list_del(&cdev->list);
 	if (list_empty(&console_list))
 		initialized = CONSOLE_UNINITIALIZED;
@@ -551,6 +645,7 @@ void console_flush(void)
 	struct console_device *cdev;
 
 	for_each_console(cdev) {
+		console_tx_drain(cdev, true);
 		if (cdev->flush)
 			cdev->flush(cdev);
 	}
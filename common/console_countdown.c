@@ -20,6 +20,7 @@
 #include <clock.h>
 #include <command.h>
 #include <errno.h>
+#include <poller.h>
 #include <console_countdown.h>
 #include <stdio.h>
 
@@ -45,6 +46,8 @@ int console_countdown(int timeout_s, unsigned flags, char *out_key)
 		printf("%4d", countdown--);
 
 	do {
+		poller_work_run();
+
 		if (tstc()) {
 			key = getchar();
 			if (flags & CONSOLE_COUNTDOWN_ANYKEY)
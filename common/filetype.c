@@ -64,6 +64,8 @@ static const struct filetype_str filetype_str[] = {
 	[filetype_mxs_bootstream] = { "Freescale MXS bootstream", "mxsbs" },
 	[filetype_socfpga_xload] = { "SoCFPGA prebootloader image", "socfpga-xload" },
 	[filetype_kwbimage_v1] = { "MVEBU kwbimage (v1)", "kwb" },
+	[filetype_android_sparse] = { "Android sparse image", "sparse" },
+	[filetype_barebox_delta] = { "barebox delta image", "delta" },
 };
 
 const char *file_type_to_string(enum filetype f)
@@ -287,6 +289,10 @@ enum filetype file_detect_type(const void *_buf, size_t bufsize)
 		return filetype_oftree;
 	if (strncmp(buf8, "ANDROID!", 8) == 0)
 		return filetype_aimage;
+	if (buf[0] == le32_to_cpu(0xed26ff3a))
+		return filetype_android_sparse;
+	if (buf[0] == le32_to_cpu(0x746c6462))
+		return filetype_barebox_delta;
 	if (buf64[0] == le64_to_cpu(0x0a1a0a0d474e5089ull))
 		return filetype_png;
 	if (is_barebox_mips_head(_buf))
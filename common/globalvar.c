@@ -282,6 +282,26 @@ int nvvar_remove(const char *name)
 	return 0;
 }
 
+static void nvvar_apply_journal(const char *name, const char *value)
+{
+	int ret;
+
+	if (!value) {
+		nvvar_remove(name);
+		return;
+	}
+
+	ret = __nvvar_add(name, value);
+	if (ret) {
+		pr_err("failed to create nv variable %s: %s\n",
+				name, strerror(-ret));
+		return;
+	}
+
+	/* keep /env/nv in sync for a later saveenv */
+	__nv_save("/env/nv", name, value);
+}
+
 int nvvar_load(void)
 {
 	char *val;
@@ -293,8 +313,11 @@ int nvvar_load(void)
 		return -ENOSYS;
 
 	dir = opendir("/env/nv");
-	if (!dir)
+	if (!dir) {
+		if (nv_journal_enabled())
+			return nv_journal_load(nvvar_apply_journal);
 		return -ENOENT;
+	}
 
 	while ((d = readdir(dir))) {
 		if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
@@ -313,6 +336,10 @@ int nvvar_load(void)
 
 	closedir(dir);
 
+	/* the journal holds newer values than the environment */
+	if (nv_journal_enabled())
+		nv_journal_load(nvvar_apply_journal);
+
 	return 0;
 }
 
@@ -588,7 +615,8 @@ BAREBOX_MAGICVAR_NAMED(global_version, global.version, "The barebox version");
  * nvvar_save - save NV variables to persistent environment
  *
  * This saves the NV variables to the persisitent environment without saving
- * the other files in the environment that might be changed.
+ * the other files in the environment that might be changed. With a nv
+ * journal only the changed variables are appended to the journal.
  */
 int nvvar_save(void)
 {
@@ -596,6 +624,18 @@ int nvvar_save(void)
 	const char *env = default_environment_path_get();
 	int ret;
 #define TMPDIR "/.env.tmp"
+	/*
+	 * The journal is compared against the variables, not against
+	 * nv_dirty, as a saveenv makes the variables clean without updating
+	 * the journal.
+	 */
+	if (nv_journal_enabled()) {
+		ret = nv_journal_save();
+		if (!ret)
+			nv_dirty = 0;
+		return ret;
+	}
+
 	if (!nv_dirty || !env)
 		return 0;
 
@@ -126,6 +126,7 @@
 #include <binfmt.h>
 #include <init.h>
 #include <shell.h>
+#include <bootchart.h>
 
 /*cmd_boot.c*/
 extern int do_bootd(int flag, int argc, char *argv[]);      /* do_bootd */
@@ -737,6 +738,7 @@ static int run_pipe_real(struct p_context *ctx, struct pipe *pi)
 	glob_t globbuf = {};
 	int ret;
 	int rcode;
+	int sp;
 # if __GNUC__
 	/* Avoid longjmp clobbering */
 	(void) &i;
@@ -799,6 +801,9 @@ static int run_pipe_real(struct p_context *ctx, struct pipe *pi)
 		}
 		return EXIT_SUCCESS;   /* don't worry about errors in set_local_var() yet */
 	}
+	/* leave the pipe untouched, it may be run again from the script cache */
+	sp = child->sp;
+
 	for (i = 0; is_assignment(child->argv[i]); i++) {
 		p = insert_var_value(child->argv[i]);
 		rcode = set_local_var(p, 0);
@@ -806,11 +811,11 @@ static int run_pipe_real(struct p_context *ctx, struct pipe *pi)
 			return 1;
 
 		if (p != child->argv[i]) {
-			child->sp--;
+			sp--;
 			free(p);
 		}
 	}
-	if (child->sp) {
+	if (sp) {
 		char * str = NULL;
 		struct p_context ctx1;
 
@@ -851,6 +856,7 @@ static int run_list_real(struct p_context *ctx, struct pipe *pi)
 	char *save_name = NULL;
 	char **list = NULL;
 	char **save_list = NULL;
+	struct pipe *for_pipe = NULL;
 	struct pipe *rpipe;
 	int flag_rep = 0;
 	int rcode=0, flag_skip=1;
@@ -879,8 +885,10 @@ static int run_list_real(struct p_context *ctx, struct pipe *pi)
 		if (pi->r_mode == RES_WHILE || pi->r_mode == RES_UNTIL ||
 				pi->r_mode == RES_FOR) {
 			/* check Ctrl-C */
-			if (ctrlc())
-				return 1;
+			if (ctrlc()) {
+				rcode = 1;
+				goto out;
+			}
 			flag_restore = 0;
 			if (!rpipe) {
 				flag_rep = 0;
@@ -922,6 +930,7 @@ static int run_list_real(struct p_context *ctx, struct pipe *pi)
 					pi->progs->argv[0]);
 				save_list = list;
 				save_name = pi->progs->argv[0];
+				for_pipe = pi;
 				pi->progs->argv[0] = NULL;
 				flag_rep = 1;
 			}
@@ -963,7 +972,7 @@ static int run_list_real(struct p_context *ctx, struct pipe *pi)
 
 		if (rcode < -1) {
 			last_return_code = -rcode - 2;
-			return rcode;	/* exit */
+			goto out;	/* exit */
 		}
 
 		last_return_code = rcode;
@@ -981,6 +990,16 @@ static int run_list_real(struct p_context *ctx, struct pipe *pi)
 		     (rcode != EXIT_SUCCESS && pi->followup == PIPE_AND) )
 			skip_more_in_this_rmode = rmode;
 	}
+out:
+	/* leaving a for loop early, restore its variable name */
+	if (list) {
+		free(for_pipe->progs->argv[0]);
+		while (*list)
+			free(*list++);
+		free(save_list);
+		for_pipe->progs->argv[0] = save_name;
+	}
+
 	return rcode;
 }
 
@@ -1887,10 +1906,206 @@ static int execute_script(const char *path, int argc, char *argv[])
 	return ret;
 }
 
+#ifdef CONFIG_HUSH_SCRIPT_CACHE
+/*
+ * Scripts are parsed statement by statement while they are executed. Scripts
+ * which run over and over again, like boot entries or menu actions, are
+ * parsed once into a list of statements instead, which is kept together
+ * with the script text and executed again as long as the text is unchanged.
+ * Our filesystems have no modification times, but comparing the text is
+ * cheap compared to parsing it.
+ */
+struct hush_script {
+	struct list_head list;
+	char *path;
+	char *text;
+	size_t len;
+	struct pipe **stmts;
+	int num_stmts;
+	int running;
+};
+
+#define HUSH_SCRIPT_CACHE_SIZE	32
+
+static LIST_HEAD(hush_script_cache);
+static int hush_script_cache_num;
+
+static void hush_script_free(struct hush_script *hs)
+{
+	int i;
+
+	for (i = 0; i < hs->num_stmts; i++)
+		free_pipe_list(hs->stmts[i], 0);
+
+	list_del(&hs->list);
+	hush_script_cache_num--;
+	free(hs->stmts);
+	free(hs->path);
+	free(hs->text);
+	free(hs);
+}
+
+/*
+ * Positional parameters are expanded while parsing and can be shifted by
+ * getopt, a different IFS changes the parsing of the following statements.
+ * Scripts using them are not cached.
+ */
+static bool hush_script_cacheable(const char *script)
+{
+	const char *p;
+
+	if (!*script || strstr(script, "IFS"))
+		return false;
+
+	for (p = strchr(script, '$'); p; p = strchr(p + 1, '$'))
+		if (isdigit(p[1]) || p[1] == '#' || p[1] == '*')
+			return false;
+
+	return true;
+}
+
+/* Parse a whole script without executing it, see parse_stream_outer() */
+static int hush_script_parse(struct hush_script *hs, const char *script)
+{
+	struct p_context ctx = {};
+	o_string temp = NULL_O_STRING;
+	struct in_str input;
+	char *p;
+	int rcode;
+
+	p = basprintf("%s\n", script);
+	setup_string_in_str(&input, p);
+
+	do {
+		ctx.type = FLAG_PARSE_SEMICOLON;
+		initialize_context(&ctx);
+		update_ifs_map();
+
+		input.promptmode = 1;
+		rcode = parse_stream(&temp, &ctx, &input, '\n');
+
+		if (rcode == 1 || ctx.old_flag != 0) {
+			if (ctx.old_flag != 0)
+				free(ctx.stack);
+			free_pipe_list(ctx.list_head, 0);
+			b_free(&temp);
+			free(p);
+			return -EINVAL;
+		}
+
+		done_word(&temp, &ctx);
+		done_pipe(&ctx, PIPE_SEQ);
+
+		if (ctx.list_head->num_progs) {
+			hs->stmts = xrealloc(hs->stmts,
+				(hs->num_stmts + 1) * sizeof(*hs->stmts));
+			hs->stmts[hs->num_stmts++] = ctx.list_head;
+		} else {
+			free_pipe_list(ctx.list_head, 0);
+		}
+
+		b_free(&temp);
+	} while (rcode != -1);
+
+	free(p);
+
+	return 0;
+}
+
+static struct hush_script *hush_script_get(const char *path, char *script,
+					   size_t len)
+{
+	struct hush_script *hs, *tmp;
+
+	list_for_each_entry(hs, &hush_script_cache, list) {
+		if (strcmp(hs->path, path))
+			continue;
+
+		if (hs->len == len && !memcmp(hs->text, script, len)) {
+			/* most recently used first */
+			list_move(&hs->list, &hush_script_cache);
+			return hs->running ? NULL : hs;
+		}
+
+		if (hs->running)
+			return NULL;
+
+		hush_script_free(hs);
+		break;
+	}
+
+	if (!hush_script_cacheable(script))
+		return NULL;
+
+	hs = xzalloc(sizeof(*hs));
+
+	if (hush_script_parse(hs, script)) {
+		free(hs->stmts);
+		free(hs);
+		return NULL;
+	}
+
+	hs->path = xstrdup(path);
+	hs->text = xmemdup(script, len);
+	hs->len = len;
+
+	list_add(&hs->list, &hush_script_cache);
+	hush_script_cache_num++;
+
+	/* drop the least recently used scripts */
+	list_for_each_entry_safe_reverse(hs, tmp, &hush_script_cache, list) {
+		if (hush_script_cache_num <= HUSH_SCRIPT_CACHE_SIZE)
+			break;
+		if (!hs->running)
+			hush_script_free(hs);
+	}
+
+	return list_first_entry(&hush_script_cache, struct hush_script, list);
+}
+
+static int hush_script_run(struct p_context *ctx, struct hush_script *hs)
+{
+	int i, code = 0;
+
+	hs->running++;
+
+	for (i = 0; i < hs->num_stmts; i++) {
+		/* like initialize_context() does for each statement */
+		release_context(ctx);
+		ctx->options_parsed = 0;
+		INIT_LIST_HEAD(&ctx->options);
+
+		code = run_list_real(ctx, hs->stmts[i]);
+		if (code < -1)
+			break;
+	}
+
+	hs->running--;
+
+	return code;
+}
+#else
+struct hush_script;
+
+static struct hush_script *hush_script_get(const char *path, char *script,
+					   size_t len)
+{
+	return NULL;
+}
+
+static int hush_script_run(struct p_context *ctx, struct hush_script *hs)
+{
+	return 0;
+}
+#endif
+
 static int source_script(const char *path, int argc, char *argv[])
 {
 	struct p_context ctx = {};
+	struct hush_script *hs;
+	uint64_t start = bootchart_start();
 	char *script;
+	size_t len;
 	int ret;
 
 	initialize_context(&ctx);
@@ -1898,19 +2113,29 @@ static int source_script(const char *path, int argc, char *argv[])
 	ctx.global_argc = argc;
 	ctx.global_argv = argv;
 
-	script = read_file(path, NULL);
+	script = read_file(path, &len);
 	if (!script) {
 		perror("sh");
 		return 1;
 	}
 
-	ret = parse_string_outer(&ctx, script, FLAG_PARSE_SEMICOLON);
+	hs = hush_script_get(path, script, len);
+	if (hs) {
+		/* the cached statements are used instead of this one */
+		free_pipe_list(ctx.list_head, 0);
+		ret = hush_script_run(&ctx, hs);
+	} else {
+		ret = parse_string_outer(&ctx, script, FLAG_PARSE_SEMICOLON);
+	}
+
 	if (ret < -1)
 		ret = -ret - 2;
 
 	release_context(&ctx);
 	free(script);
 
+	bootchart_record(BOOTCHART_SCRIPT, path, NULL, 0, start);
+
 	return ret;
 }
 
@@ -1922,6 +2147,7 @@ int run_shell(void)
 	int exit = 0;
 
 	login();
+	bootchart_stop();
 
 	do {
 		setup_file_in_str(&input);
@@ -395,14 +395,98 @@ err_digest_free:
 	return ret;
 }
 
+struct fit_ext_data {
+	void *buf;
+	struct list_head list;
+};
+
+/*
+ * Get the data of an image node. Images built with 'mkimage -E' store
+ * their data after the FDT structure and only describe it with
+ * data-offset (relative to the end of the structure) or data-position
+ * (absolute) and data-size. When only the structure has been read,
+ * just the data of this image is read from the source file.
+ */
+static int fit_get_image_data(struct fit_handle *handle, struct device_node *image,
+			      const void **outdata, int *outsize)
+{
+	struct fit_ext_data *ext;
+	const void *data;
+	int data_len;
+	u32 ofs, size;
+	loff_t pos;
+	int ret;
+
+	data = of_get_property(image, "data", &data_len);
+	if (data) {
+		*outdata = data;
+		*outsize = data_len;
+		return 0;
+	}
+
+	if (of_property_read_u32(image, "data-size", &size))
+		return -ENOENT;
+
+	if (!of_property_read_u32(image, "data-position", &ofs))
+		pos = ofs;
+	else if (!of_property_read_u32(image, "data-offset", &ofs))
+		pos = ALIGN(fdt32_to_cpu(((struct fdt_header *)handle->fit)->totalsize), 4) + ofs;
+	else
+		return -ENOENT;
+
+	if (size > INT_MAX)
+		return -EINVAL;
+
+	if (pos + size <= handle->size) {
+		*outdata = handle->fit + pos;
+		*outsize = size;
+		return 0;
+	}
+
+	if (handle->fd < 0 || handle->mapped)
+		return -EINVAL;
+
+	ext = xzalloc(sizeof(*ext));
+	ext->buf = malloc(size);
+	if (!ext->buf) {
+		free(ext);
+		return -ENOMEM;
+	}
+
+	if (lseek(handle->fd, pos, SEEK_SET) != pos) {
+		ret = -errno;
+		goto err;
+	}
+
+	ret = read_full(handle->fd, ext->buf, size);
+	if (ret < 0)
+		goto err;
+	if (ret < size) {
+		ret = -EINVAL;
+		goto err;
+	}
+
+	list_add_tail(&ext->list, &handle->ext_data);
+
+	*outdata = ext->buf;
+	*outsize = size;
+
+	return 0;
+err:
+	free(ext->buf);
+	free(ext);
+
+	return ret;
+}
+
 static int fit_open_image(struct fit_handle *handle, const char *unit, const void **outdata,
 	unsigned long *outsize)
 {
 	struct device_node *image = NULL, *hash;
 	const char *type = NULL, *desc= "(no description)";
-	const void *data;
-	int data_len;
-	int ret = 0;
+	const void *data = NULL;
+	int data_len = 0;
+	int ret;
 
 	image = of_get_child_by_name(handle->root, "images");
 	if (!image)
@@ -421,10 +505,10 @@ static int fit_open_image(struct fit_handle *handle, const char *unit, const voi
 		return -EINVAL;
 	}
 
-	data = of_get_property(image, "data", &data_len);
-	if (!data) {
+	ret = fit_get_image_data(handle, image, &data, &data_len);
+	if (ret) {
 		pr_err("data not found\n");
-		return -EINVAL;
+		return ret == -ENOENT ? -EINVAL : ret;
 	}
 
 	if (handle->verify > BOOTM_VERIFY_NONE) {
@@ -541,6 +625,85 @@ static int fit_open_configuration(struct fit_handle *handle, const char *name)
 	return 0;
 }
 
+/*
+ * Make the FIT image available in memory. Memory mappable sources are
+ * used directly. Otherwise only the FDT structure is read; image data
+ * stored outside of it is read later on demand by fit_get_image_data().
+ */
+static int fit_load(struct fit_handle *handle, const char *filename)
+{
+	struct fdt_header header;
+	struct stat s;
+	size_t totalsize;
+	void *map;
+	int ret;
+
+	ret = stat(filename, &s);
+	if (ret)
+		return ret;
+
+	if (s.st_size == FILESIZE_MAX)
+		return read_file_2(filename, &handle->size, &handle->fit,
+				   FILESIZE_MAX);
+
+	handle->fd = open(filename, O_RDONLY);
+	if (handle->fd < 0)
+		return handle->fd;
+
+	map = memmap(handle->fd, PROT_READ);
+	if (map != (void *)-1) {
+		handle->fit = map;
+		handle->size = s.st_size;
+		handle->mapped = true;
+		return 0;
+	}
+
+	ret = read_full(handle->fd, &header, sizeof(header));
+	if (ret < 0)
+		return ret;
+	if (ret < sizeof(header) || fdt32_to_cpu(header.magic) != FDT_MAGIC)
+		return -EINVAL;
+
+	totalsize = fdt32_to_cpu(header.totalsize);
+	if (totalsize < sizeof(header) || totalsize > s.st_size)
+		return -EINVAL;
+
+	handle->fit = malloc(totalsize);
+	if (!handle->fit)
+		return -ENOMEM;
+
+	memcpy(handle->fit, &header, sizeof(header));
+
+	ret = read_full(handle->fd, handle->fit + sizeof(header),
+			totalsize - sizeof(header));
+	if (ret < 0)
+		return ret;
+	if (ret < totalsize - sizeof(header))
+		return -EINVAL;
+
+	handle->size = totalsize;
+
+	return 0;
+}
+
+static void fit_unload(struct fit_handle *handle)
+{
+	struct fit_ext_data *ext, *tmp;
+
+	list_for_each_entry_safe(ext, tmp, &handle->ext_data, list) {
+		free(ext->buf);
+		free(ext);
+	}
+
+	if (handle->root)
+		of_delete_node(handle->root);
+	if (!handle->mapped)
+		free(handle->fit);
+	if (handle->fd >= 0)
+		close(handle->fd);
+	free(handle);
+}
+
 struct fit_handle *fit_open(const char *filename, const char *config, bool verbose,
 			    enum bootm_verify verify)
 {
@@ -551,16 +714,19 @@ struct fit_handle *fit_open(const char *filename, const char *config, bool verbo
 	handle = xzalloc(sizeof(struct fit_handle));
 
 	handle->verbose = verbose;
+	handle->fd = -1;
+	INIT_LIST_HEAD(&handle->ext_data);
 
-	ret = read_file_2(filename, &handle->size, &handle->fit, FILESIZE_MAX);
+	ret = fit_load(handle, filename);
 	if (ret) {
 		pr_err("unable to read %s: %s\n", filename, strerror(-ret));
 		goto err;
 	}
 
-	handle->root = of_unflatten_dtb(handle->fit);
+	handle->root = of_unflatten_dtb_const(handle->fit);
 	if (IS_ERR(handle->root)) {
 		ret = PTR_ERR(handle->root);
+		handle->root = NULL;
 		goto err;
 	}
 
@@ -575,29 +741,23 @@ struct fit_handle *fit_open(const char *filename, const char *config, bool verbo
 
 	return handle;
  err:
-	if (handle->root)
-		of_delete_node(handle->root);
-	free(handle->fit);
-	free(handle);
+	fit_unload(handle);
 
 	return ERR_PTR(ret);
 }
 
 void fit_close(struct fit_handle *handle)
 {
-	if (handle->root)
-		of_delete_node(handle->root);
-	if (handle->fit)
-		free(handle->fit);
-	free(handle);
+	fit_unload(handle);
 }
 
 #ifdef CONFIG_SANDBOX
 static int do_bootm_sandbox_fit(struct image_data *data)
 {
 	struct fit_handle *handle;
-	handle = fit_open(data->os_file, data->os_part, data->verbose);
-	if (handle)
+	handle = fit_open(data->os_file, data->os_part, data->verbose,
+			  data->verify);
+	if (!IS_ERR(handle))
 		fit_close(handle);
 	return 0;
 }
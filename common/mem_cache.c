@@ -0,0 +1,140 @@
+/*
+ * mem_cache.c - pools for small fixed size objects
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#include <common.h>
+#include <malloc.h>
+#include <mem_cache.h>
+
+/* Slabs are sized to hold at least MEM_CACHE_MIN_OBJS objects */
+#define MEM_CACHE_SLAB_SIZE	2048
+#define MEM_CACHE_MIN_OBJS	8
+#define MEM_CACHE_ALIGN		8
+
+struct mem_cache_slab {
+	struct list_head list;
+} __aligned(MEM_CACHE_ALIGN);
+
+static LIST_HEAD(mem_caches);
+
+static size_t mem_cache_objsize(struct mem_cache *cache)
+{
+	return ALIGN(max(cache->size, sizeof(void *)), MEM_CACHE_ALIGN);
+}
+
+static int mem_cache_grow(struct mem_cache *cache)
+{
+	struct mem_cache_slab *slab;
+	size_t objsize = mem_cache_objsize(cache);
+	void *obj;
+	int i;
+
+	if (!cache->objs_per_slab) {
+		cache->objs_per_slab = max_t(unsigned int, MEM_CACHE_MIN_OBJS,
+				(MEM_CACHE_SLAB_SIZE - sizeof(*slab)) / objsize);
+		list_add_tail(&cache->list, &mem_caches);
+	}
+
+	slab = malloc(sizeof(*slab) + cache->objs_per_slab * objsize);
+	if (!slab)
+		return -ENOMEM;
+
+	list_add(&slab->list, &cache->slabs);
+	cache->nr_slabs++;
+
+	obj = slab + 1;
+	for (i = 0; i < cache->objs_per_slab; i++) {
+		*(void **)obj = cache->freelist;
+		cache->freelist = obj;
+		obj += objsize;
+	}
+
+	return 0;
+}
+
+static void mem_cache_release(struct mem_cache *cache)
+{
+	struct mem_cache_slab *slab, *tmp;
+
+	list_for_each_entry_safe(slab, tmp, &cache->slabs, list) {
+		list_del(&slab->list);
+		free(slab);
+	}
+
+	cache->freelist = NULL;
+	cache->nr_slabs = 0;
+}
+
+/**
+ * mem_cache_alloc - allocate an object from a cache
+ * @cache:	the cache
+ *
+ * Return: a zeroed object of @cache->size bytes. Like xzalloc() this
+ * panics when no memory is left.
+ */
+void *mem_cache_alloc(struct mem_cache *cache)
+{
+	void *obj;
+
+	if (!cache->freelist && mem_cache_grow(cache))
+		panic("ERROR: out of memory\n");
+
+	obj = cache->freelist;
+	cache->freelist = *(void **)obj;
+
+	cache->allocs++;
+	cache->in_use++;
+	if (cache->in_use > cache->max_in_use)
+		cache->max_in_use = cache->in_use;
+
+	memset(obj, 0, cache->size);
+
+	return obj;
+}
+
+/**
+ * mem_cache_free - return an object to its cache
+ * @cache:	the cache @obj was allocated from
+ * @obj:	the object, may be NULL
+ */
+void mem_cache_free(struct mem_cache *cache, void *obj)
+{
+	if (!obj)
+		return;
+
+	*(void **)obj = cache->freelist;
+	cache->freelist = obj;
+
+	if (!--cache->in_use)
+		mem_cache_release(cache);
+}
+
+void mem_cache_print_stats(void)
+{
+	struct mem_cache *cache;
+
+	if (list_empty(&mem_caches))
+		return;
+
+	printf("%-16s %7s %7s %7s %9s %5s %8s\n", "cache", "objsize",
+	       "active", "peak", "allocs", "slabs", "memory");
+
+	list_for_each_entry(cache, &mem_caches, list) {
+		size_t objsize = mem_cache_objsize(cache);
+
+		printf("%-16s %7zu %7u %7u %9lu %5u %8s\n", cache->name,
+		       objsize, cache->in_use, cache->max_in_use,
+		       cache->allocs, cache->nr_slabs,
+		       size_human_readable((unsigned long long)cache->nr_slabs *
+				(sizeof(struct mem_cache_slab) +
+				 cache->objs_per_slab * objsize)));
+	}
+}
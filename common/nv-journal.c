@@ -0,0 +1,576 @@
+/*
+ * nv-journal.c - append-only storage for nv variables
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * The journal lives on a raw partition which is split into two halves.
+ * Each half starts with a header carrying a generation number, followed
+ * by records, each setting or removing a single nv variable. The half
+ * with the valid header of the highest generation is the active one.
+ * Saving appends records for the variables which changed since the
+ * last save to the active half. When it is full, a snapshot of all nv
+ * variables is written to the other half, the header last, so that a
+ * power cut during compaction leaves the old half in effect.
+ */
+#define pr_fmt(fmt) "nv-journal: " fmt
+
+#include <common.h>
+#include <malloc.h>
+#include <globalvar.h>
+#include <errno.h>
+#include <fs.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <crc.h>
+#include <ioctl.h>
+#include <linux/list.h>
+#include <linux/mtd/mtd-abi.h>
+
+#define NV_JOURNAL_MAGIC	0x6e766a68	/* "nvjh" */
+#define NV_JOURNAL_REC_MAGIC	0x6e766a72	/* "nvjr" */
+#define NV_JOURNAL_REMOVED	0xffff
+
+struct nv_journal_header {
+	__le32 magic;
+	__le32 generation;
+	__le32 reserved;
+	__le32 crc;
+};
+
+struct nv_journal_record {
+	__le32 magic;
+	__le32 generation;
+	__le16 namelen;
+	__le16 vallen;		/* NV_JOURNAL_REMOVED for removed variables */
+	__le32 crc;		/* over the record with crc = 0 and the payload */
+};
+
+/* The variables as they are stored in the journal */
+struct nv_journal_var {
+	struct list_head list;
+	char *name;
+	char *value;
+};
+
+static char *nv_journal_path;
+static LIST_HEAD(nv_journal_vars);
+static loff_t nv_journal_halfsize;
+static int nv_journal_active = -1;	/* active half, -1 if none */
+static u32 nv_journal_gen;
+static loff_t nv_journal_end;		/* write offset in the active half */
+
+/**
+ * nv_journal_set_path - use a partition as nv journal
+ * @path: the partition, usually a device file in /dev
+ *
+ * The partition should span an even number of erase blocks. Once set,
+ * nvvar_load() applies the journal on top of the nv variables from the
+ * environment and nvvar_save() only appends to the journal instead of
+ * rewriting the environment.
+ */
+void nv_journal_set_path(const char *path)
+{
+	free(nv_journal_path);
+	nv_journal_path = xstrdup(path);
+	nv_journal_active = -1;
+}
+
+int nv_journal_enabled(void)
+{
+	return nv_journal_path != NULL;
+}
+
+static struct nv_journal_var *nv_journal_find(const char *name)
+{
+	struct nv_journal_var *var;
+
+	list_for_each_entry(var, &nv_journal_vars, list)
+		if (!strcmp(var->name, name))
+			return var;
+
+	return NULL;
+}
+
+static void nv_journal_update(const char *name, const char *value)
+{
+	struct nv_journal_var *var;
+
+	var = nv_journal_find(name);
+	if (!var) {
+		var = xzalloc(sizeof(*var));
+		var->name = xstrdup(name);
+		list_add_tail(&var->list, &nv_journal_vars);
+	}
+
+	free(var->value);
+	var->value = value ? xstrdup(value) : NULL;
+}
+
+static void nv_journal_clear(void)
+{
+	struct nv_journal_var *var, *tmp;
+
+	list_for_each_entry_safe(var, tmp, &nv_journal_vars, list) {
+		list_del(&var->list);
+		free(var->name);
+		free(var->value);
+		free(var);
+	}
+}
+
+static size_t nv_journal_record_size(const char *name, const char *value)
+{
+	return sizeof(struct nv_journal_record) +
+		ALIGN(strlen(name) + (value ? strlen(value) : 0), 4);
+}
+
+/*
+ * Put a record into buf. Returns the size of the record, buf may be NULL
+ * to only calculate the size.
+ */
+static size_t nv_journal_put_record(void *buf, u32 gen, const char *name,
+				    const char *value)
+{
+	struct nv_journal_record *rec = buf;
+	size_t namelen = strlen(name);
+	size_t vallen = value ? strlen(value) : 0;
+	size_t size = nv_journal_record_size(name, value);
+	u32 crc;
+
+	if (!buf)
+		return size;
+
+	memset(buf, 0, size);
+	rec->magic = cpu_to_le32(NV_JOURNAL_REC_MAGIC);
+	rec->generation = cpu_to_le32(gen);
+	rec->namelen = cpu_to_le16(namelen);
+	rec->vallen = cpu_to_le16(value ? vallen : NV_JOURNAL_REMOVED);
+	memcpy(buf + sizeof(*rec), name, namelen);
+	memcpy(buf + sizeof(*rec) + namelen, value, vallen);
+
+	crc = crc32(0, buf, sizeof(*rec) + namelen + vallen);
+	rec->crc = cpu_to_le32(crc);
+
+	return size;
+}
+
+/*
+ * Check the record at buf, which has len bytes available. Returns the
+ * size of the record or 0 if there is no valid record.
+ */
+static size_t nv_journal_check_record(void *buf, size_t len, u32 gen)
+{
+	struct nv_journal_record rec;
+	size_t namelen, vallen, size;
+	u32 crc;
+
+	if (len < sizeof(rec))
+		return 0;
+
+	memcpy(&rec, buf, sizeof(rec));
+
+	if (le32_to_cpu(rec.magic) != NV_JOURNAL_REC_MAGIC ||
+	    le32_to_cpu(rec.generation) != gen)
+		return 0;
+
+	namelen = le16_to_cpu(rec.namelen);
+	vallen = le16_to_cpu(rec.vallen);
+	if (vallen == NV_JOURNAL_REMOVED)
+		vallen = 0;
+
+	size = sizeof(rec) + ALIGN(namelen + vallen, 4);
+	if (!namelen || size > len)
+		return 0;
+
+	crc = le32_to_cpu(rec.crc);
+	rec.crc = 0;
+	memcpy(buf, &rec, sizeof(rec));
+	if (crc32(0, buf, sizeof(rec) + namelen + vallen) != crc)
+		return 0;
+
+	return size;
+}
+
+static void nv_journal_apply_record(void *buf)
+{
+	struct nv_journal_record *rec = buf;
+	size_t namelen = le16_to_cpu(rec->namelen);
+	size_t vallen = le16_to_cpu(rec->vallen);
+	char *name, *value = NULL;
+
+	name = xstrndup(buf + sizeof(*rec), namelen);
+	if (vallen != NV_JOURNAL_REMOVED)
+		value = xstrndup(buf + sizeof(*rec) + namelen, vallen);
+
+	nv_journal_update(name, value);
+
+	free(name);
+	free(value);
+}
+
+static int nv_journal_read_header(int fd, int half, u32 *gen)
+{
+	struct nv_journal_header hdr;
+	ssize_t now;
+
+	now = pread(fd, &hdr, sizeof(hdr), half * nv_journal_halfsize);
+	if (now < 0)
+		return -errno;
+	if (now < sizeof(hdr))
+		return -EINVAL;
+
+	if (le32_to_cpu(hdr.magic) != NV_JOURNAL_MAGIC ||
+	    crc32(0, &hdr, sizeof(hdr) - 4) != le32_to_cpu(hdr.crc))
+		return -EINVAL;
+
+	*gen = le32_to_cpu(hdr.generation);
+
+	return 0;
+}
+
+/*
+ * Read the journal into nv_journal_vars and find the place for the next
+ * record.
+ */
+/*
+ * Flash can't be overwritten without an erase, writing to it only clears
+ * bits. Returns true if fd is such a device.
+ */
+static bool nv_journal_is_flash(int fd)
+{
+	struct mtd_info_user info;
+
+	if (!IS_ENABLED(CONFIG_MTD))
+		return false;
+
+	if (ioctl(fd, MEMGETINFO, &info))
+		return false;
+
+	return info.type != MTD_RAM;
+}
+
+static int nv_journal_read(void)
+{
+	struct stat s;
+	int fd, ret, half, active = -1;
+	u32 gen = 0, active_gen = 0;
+	void *buf;
+	size_t len, pos, size;
+
+	nv_journal_clear();
+	nv_journal_active = -1;
+
+	ret = stat(nv_journal_path, &s);
+	if (ret)
+		return ret;
+
+	nv_journal_halfsize = s.st_size / 2;
+	if (nv_journal_halfsize < sizeof(struct nv_journal_header))
+		return -EINVAL;
+
+	fd = open(nv_journal_path, O_RDONLY);
+	if (fd < 0)
+		return fd;
+
+	for (half = 0; half < 2; half++) {
+		if (nv_journal_read_header(fd, half, &gen))
+			continue;
+		if (active < 0 || (s32)(gen - active_gen) > 0) {
+			active = half;
+			active_gen = gen;
+		}
+	}
+
+	if (active < 0) {
+		pr_debug("no valid journal on %s\n", nv_journal_path);
+		nv_journal_gen = 0;
+		ret = 0;
+		goto out;
+	}
+
+	len = nv_journal_halfsize - sizeof(struct nv_journal_header);
+	buf = malloc(len);
+	if (!buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = pread(fd, buf, len, active * nv_journal_halfsize +
+		    sizeof(struct nv_journal_header));
+	if (ret < 0) {
+		ret = -errno;
+		free(buf);
+		goto out;
+	}
+
+	len = ret;
+
+	for (pos = 0; pos < len; pos += size) {
+		size = nv_journal_check_record(buf + pos, len - pos, active_gen);
+		if (!size)
+			break;
+		nv_journal_apply_record(buf + pos);
+	}
+
+	nv_journal_active = active;
+	nv_journal_gen = active_gen;
+	nv_journal_end = sizeof(struct nv_journal_header) + pos;
+	ret = 0;
+
+	/*
+	 * A torn append leaves programmed bytes behind the last valid record.
+	 * Records appended over them on flash would be corrupt, so compact
+	 * into the other half with the next save instead.
+	 */
+	if (pos < len && nv_journal_is_flash(fd) &&
+	    memchr_inv(buf + pos, 0xff, len - pos)) {
+		pr_warn("garbage behind the last record, compacting on next save\n");
+		nv_journal_end = nv_journal_halfsize;
+	}
+
+	free(buf);
+
+	pr_debug("generation %u in half %d, %lld bytes used\n", active_gen,
+		 active, nv_journal_end);
+out:
+	close(fd);
+
+	return ret;
+}
+
+/**
+ * nv_journal_load - read the nv journal
+ * @apply: called for each variable in the journal, with a NULL value
+ *         for removed variables
+ */
+int nv_journal_load(void (*apply)(const char *name, const char *value))
+{
+	struct nv_journal_var *var;
+	int ret;
+
+	if (!nv_journal_path)
+		return -ENOENT;
+
+	ret = nv_journal_read();
+	if (ret) {
+		pr_err("Cannot read %s: %s\n", nv_journal_path, strerror(-ret));
+		return ret;
+	}
+
+	list_for_each_entry(var, &nv_journal_vars, list)
+		apply(var->name, var->value);
+
+	return 0;
+}
+
+/*
+ * The lengths in a record are 16 bit and a value length of 0xffff marks a
+ * removed variable, so longer names and values can't be stored.
+ */
+static int nv_journal_check_lengths(void)
+{
+	struct param_d *param;
+
+	list_for_each_entry(param, &nv_device.parameters, list) {
+		const char *val = dev_get_param(&nv_device, param->name);
+
+		if (strlen(param->name) >= NV_JOURNAL_REMOVED ||
+		    (val && strlen(val) >= NV_JOURNAL_REMOVED)) {
+			pr_err("nv.%s is too long for the journal\n",
+			       param->name);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Put records for all nv variables which differ from the journal into
+ * buf, or for all nv variables if full is true. Returns the size needed,
+ * buf may be NULL to only calculate the size.
+ */
+static size_t nv_journal_collect(void *buf, u32 gen, bool full)
+{
+	struct param_d *param;
+	struct nv_journal_var *var;
+	size_t size = 0;
+
+	list_for_each_entry(param, &nv_device.parameters, list) {
+		const char *val = dev_get_param(&nv_device, param->name);
+
+		if (!val)
+			val = "";
+
+		if (!full) {
+			var = nv_journal_find(param->name);
+			if (var && var->value && !strcmp(var->value, val))
+				continue;
+		}
+
+		size += nv_journal_put_record(buf ? buf + size : NULL, gen,
+					      param->name, val);
+	}
+
+	if (full)
+		return size;
+
+	list_for_each_entry(var, &nv_journal_vars, list) {
+		if (!var->value || get_param_by_name(&nv_device, var->name))
+			continue;
+
+		size += nv_journal_put_record(buf ? buf + size : NULL, gen,
+					      var->name, NULL);
+	}
+
+	return size;
+}
+
+static int nv_journal_write(int fd, const void *buf, size_t len, loff_t offset)
+{
+	while (len) {
+		ssize_t now = pwrite(fd, buf, len, offset);
+		if (now < 0)
+			return -errno;
+
+		buf += now;
+		len -= now;
+		offset += now;
+	}
+
+	return 0;
+}
+
+/*
+ * Write a snapshot of all nv variables to the inactive half and make it
+ * the active one.
+ */
+static int nv_journal_compact(int fd)
+{
+	struct nv_journal_header hdr;
+	int half = nv_journal_active == 0 ? 1 : 0;
+	loff_t start = half * nv_journal_halfsize;
+	u32 gen = nv_journal_gen + 1;
+	size_t size;
+	void *buf;
+	int ret;
+
+	size = nv_journal_collect(NULL, gen, true);
+	if (size + sizeof(hdr) > nv_journal_halfsize)
+		return -ENOSPC;
+
+	ret = erase(fd, nv_journal_halfsize, start);
+	/* ENOSYS and EOPNOTSUPP aren't errors here, many devices don't need it */
+	if (ret && errno != ENOSYS && errno != EOPNOTSUPP)
+		return -errno;
+
+	buf = xzalloc(size);
+	nv_journal_collect(buf, gen, true);
+
+	ret = nv_journal_write(fd, buf, size, start + sizeof(hdr));
+	free(buf);
+	if (ret)
+		return ret;
+
+	hdr.magic = cpu_to_le32(NV_JOURNAL_MAGIC);
+	hdr.generation = cpu_to_le32(gen);
+	hdr.reserved = 0;
+	hdr.crc = cpu_to_le32(crc32(0, &hdr, sizeof(hdr) - 4));
+
+	ret = nv_journal_write(fd, &hdr, sizeof(hdr), start);
+	if (ret)
+		return ret;
+
+	pr_debug("compacted to generation %u in half %d\n", gen, half);
+
+	nv_journal_active = half;
+	nv_journal_gen = gen;
+	nv_journal_end = sizeof(hdr) + size;
+
+	return 0;
+}
+
+/**
+ * nv_journal_save - store the changed nv variables in the journal
+ *
+ * Appends a record for each nv variable that has been changed, added or
+ * removed since the journal has been read or written last. Nothing is
+ * written when nothing changed.
+ */
+int nv_journal_save(void)
+{
+	struct param_d *param;
+	size_t size;
+	void *buf = NULL;
+	int fd, ret;
+
+	if (!nv_journal_path)
+		return -ENOENT;
+
+	if (nv_journal_active < 0) {
+		ret = nv_journal_read();
+		if (ret)
+			return ret;
+	}
+
+	ret = nv_journal_check_lengths();
+	if (ret)
+		return ret;
+
+	size = nv_journal_collect(NULL, nv_journal_gen, false);
+	if (!size)
+		return 0;
+
+	fd = open(nv_journal_path, O_RDWR);
+	if (fd < 0)
+		return fd;
+
+	ret = protect(fd, ~0, 0, 0);
+	/* ENOSYS and EOPNOTSUPP aren't errors here, many devices don't need it */
+	if (ret && errno != ENOSYS && errno != EOPNOTSUPP) {
+		ret = -errno;
+		goto out;
+	}
+
+	if (nv_journal_active < 0 ||
+	    nv_journal_end + size > nv_journal_halfsize) {
+		ret = nv_journal_compact(fd);
+	} else {
+		buf = xzalloc(size);
+		nv_journal_collect(buf, nv_journal_gen, false);
+
+		ret = nv_journal_write(fd, buf, size, nv_journal_active *
+				       nv_journal_halfsize + nv_journal_end);
+		if (!ret)
+			nv_journal_end += size;
+	}
+
+	protect(fd, ~0, 0, 1);
+
+	if (ret)
+		goto out;
+
+	/* the journal now holds exactly the current nv variables */
+	nv_journal_clear();
+	list_for_each_entry(param, &nv_device.parameters, list)
+		nv_journal_update(param->name,
+				  dev_get_param(&nv_device, param->name));
+out:
+	free(buf);
+	close(fd);
+
+	if (ret) {
+		/* force reading the journal again before the next save */
+		nv_journal_active = -1;
+		pr_err("Cannot write %s: %s\n", nv_journal_path, strerror(-ret));
+	}
+
+	return ret;
+}
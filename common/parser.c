@@ -3,6 +3,7 @@
 #include <password.h>
 #include <environment.h>
 #include <shell.h>
+#include <bootchart.h>
 
 /*
  * not yet supported
@@ -268,6 +269,7 @@ int run_shell(void)
 	int len;
 
 	login();
+	bootchart_stop();
 
 	for (;;) {
 		len = readline (CONFIG_PROMPT, console_buffer, CONFIG_CBSIZE);
@@ -119,3 +119,127 @@ void poller_call(void)
 
 	poller_active = 0;
 }
+
+static LIST_HEAD(poller_work_list);
+static struct poller_work *poller_work_current;
+
+/*
+ * Run the next stage of a background work and retire it when it is
+ * finished.
+ */
+static void poller_work_step(struct poller_work *work)
+{
+	int ret;
+
+	poller_work_current = work;
+	ret = work->fn(work);
+	poller_work_current = NULL;
+
+	if (ret > 0)
+		return;
+
+	list_del(&work->list);
+	work->result = ret;
+	work->pending = 0;
+
+	pr_debug("%s: background work finished: %d\n", work->name, ret);
+}
+
+/*
+ * Start a staged background work
+ *
+ * @work	the work to be started
+ * @name	name for diagnostic messages
+ * @fn		stage function, called until it returns <= 0
+ *
+ * Queues the work. Its stages are run from the idle points of barebox
+ * and by poller_work_wait(). Returns -EBUSY if the work is already
+ * pending.
+ */
+int poller_work_start(struct poller_work *work, const char *name,
+		int (*fn)(struct poller_work *work))
+{
+	if (work->pending)
+		return -EBUSY;
+
+	work->name = name;
+	work->fn = fn;
+	work->resume = 0;
+	work->result = -EINPROGRESS;
+	work->pending = 1;
+
+	list_add_tail(&work->list, &poller_work_list);
+
+	return 0;
+}
+
+/*
+ * Delay the next stage of a background work
+ *
+ * @work	the work, usually called from its stage function
+ * @delay_ns	minimum time in nanoseconds before the next stage is run
+ */
+void poller_work_delay(struct poller_work *work, uint64_t delay_ns)
+{
+	work->resume = get_time_ns() + delay_ns;
+}
+
+/*
+ * Wait for a background work to finish
+ *
+ * @work	the work to wait for
+ *
+ * Runs the remaining stages of the work synchronously. Returns the
+ * result of the work, 0 when it has been successful.
+ */
+int poller_work_wait(struct poller_work *work)
+{
+	if (work == poller_work_current)
+		return -EDEADLK;
+
+	while (work->pending) {
+		if (get_time_ns() < work->resume) {
+			poller_call();
+			continue;
+		}
+
+		poller_work_step(work);
+	}
+
+	return work->result;
+}
+
+/*
+ * Progress background work
+ *
+ * Runs a single stage of the first background work that is not
+ * delayed and moves it to the end of the queue, so that multiple works
+ * progress in turns. To be called from places where barebox is idle.
+ */
+void poller_work_run(void)
+{
+	struct poller_work *work;
+	uint64_t now;
+
+	if (poller_work_current)
+		return;
+
+	now = get_time_ns();
+
+	list_for_each_entry(work, &poller_work_list, list) {
+		if (now < work->resume)
+			continue;
+
+		list_move_tail(&work->list, &poller_work_list);
+		poller_work_step(work);
+		return;
+	}
+}
+
+/*
+ * Returns true if there is background work that has not finished yet
+ */
+int poller_work_busy(void)
+{
+	return !list_empty(&poller_work_list);
+}
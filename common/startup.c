@@ -42,6 +42,7 @@
 #include <asm/sections.h>
 #include <uncompress.h>
 #include <globalvar.h>
+#include <bootchart.h>
 
 extern initcall_t __barebox_initcalls_start[], __barebox_early_initcalls_end[],
 		  __barebox_initcalls_end[];
@@ -96,30 +97,45 @@ void __noreturn start_barebox(void)
 	initcall_t *initcall;
 	int result;
 	struct stat s;
+	uint64_t start, phase_start;
 
 	if (!IS_ENABLED(CONFIG_SHELL_NONE))
 		barebox_main = run_shell;
 
+	phase_start = bootchart_start();
+
 	for (initcall = __barebox_initcalls_start;
 			initcall < __barebox_initcalls_end; initcall++) {
 		pr_debug("initcall-> %pS\n", *initcall);
+		start = bootchart_start();
 		result = (*initcall)();
+		bootchart_record(BOOTCHART_INITCALL, NULL, *initcall, result,
+				 start);
 		if (result)
 			pr_err("initcall %pS failed: %s\n", *initcall,
 					strerror(-result));
 	}
 
+	bootchart_record(BOOTCHART_PHASE, "initcalls", NULL, 0, phase_start);
+
 	pr_debug("initcalls done\n");
 
 	if (IS_ENABLED(CONFIG_COMMAND_SUPPORT)) {
 		pr_info("running /env/bin/init...\n");
 
+		phase_start = bootchart_start();
+
 		if (!stat("/env/bin/init", &s))
 			run_command("source /env/bin/init");
 		else
 			pr_err("/env/bin/init not found\n");
+
+		bootchart_record(BOOTCHART_PHASE, "/env/bin/init", NULL, 0,
+				 phase_start);
 	}
 
+	bootchart_stop();
+
 	if (!barebox_main) {
 		pr_err("No main function! aborting.\n");
 		hang();
@@ -135,6 +151,7 @@ void __noreturn start_barebox(void)
 void __noreturn hang (void)
 {
 	puts ("### ERROR ### Please RESET the board ###\n");
+	console_flush();
 	for (;;);
 }
 
@@ -151,4 +168,6 @@ void shutdown_barebox(void)
 		pr_debug("exitcall-> %pS\n", *exitcall);
 		(*exitcall)();
 	}
+
+	console_flush();
 }
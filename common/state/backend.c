@@ -43,19 +43,56 @@ int state_save(struct state *state)
 		return ret;
 	}
 
+	/*
+	 * Variables were set, but to the values already stored. Write anyway
+	 * if a bucket could not be written or repaired last time.
+	 */
+	if (state->packed && !backend->storage.incomplete &&
+	    len == state->packed_len && !memcmp(buf, state->packed, len)) {
+		dev_dbg(&state->dev, "state unchanged, not writing\n");
+		goto done;
+	}
+
 	ret = state_storage_write(&backend->storage, buf, len);
 	if (ret) {
 		dev_err(&state->dev, "Failed to write packed state, %d\n", ret);
 		goto out;
 	}
 
+	free(state->packed);
+	state->packed = buf;
+	state->packed_len = len;
+	buf = NULL;
+done:
 	state->dirty = 0;
+	state->save_pending = false;
 
 out:
 	free(buf);
 	return ret;
 }
 
+/**
+ * state_save_deferred - save the state now or before barebox shuts down
+ * @param state
+ * @return 0 on success, -errno otherwise
+ *
+ * With the state's deferred_save parameter set the state is only marked
+ * to be saved. All changes until then are written with a single save
+ * before barebox starts an OS or resets, or when state_save() is called.
+ * Otherwise this is state_save().
+ */
+int state_save_deferred(struct state *state)
+{
+	if (!state->deferred_save)
+		return state_save(state);
+
+	if (state->dirty)
+		state->save_pending = true;
+
+	return 0;
+}
+
 /**
  * state_load - Loads a state from the backend
  * @param state The state that should be updated to contain the loaded data
@@ -93,6 +130,14 @@ int state_load(struct state *state)
 	}
 
 	state->dirty = 0;
+	/* the variables changed without setting their parameters */
+	state->dev.param_generation++;
+
+	free(state->packed);
+	state->packed = NULL;
+	if (backend->format->pack(backend->format, state, &state->packed,
+				  &state->packed_len))
+		state->packed = NULL;
 
 out:
 	free(buf);
@@ -101,7 +146,8 @@ out:
 
 static int state_format_init(struct state_backend *backend,
 			     struct device_d *dev, const char *backend_format,
-			     struct device_node *node, const char *state_name)
+			     struct device_node *node, const char *state_name,
+			     uint32_t stridesize)
 {
 	int ret;
 
@@ -110,6 +156,9 @@ static int state_format_init(struct state_backend *backend,
 						state_name, dev);
 	} else if (!strcmp(backend_format, "dtb")) {
 		ret = backend_format_dtb_create(&backend->format, dev);
+	} else if (!strcmp(backend_format, "journal")) {
+		ret = backend_format_journal_create(&backend->format, node,
+						    stridesize, dev);
 	} else {
 		dev_err(dev, "Invalid backend format %s\n",
 			backend_format);
@@ -135,8 +184,8 @@ static void state_format_free(struct state_backend_format *format)
  * @param backend state backend
  * @param dev Device pointer used for prints
  * @param node the DT device node corresponding to the state
- * @param backend_format a string describing the format. Valid values are 'raw'
- * and 'dtb' currently
+ * @param backend_format a string describing the format. Valid values are 'raw',
+ * 'dtb' and 'journal' currently
  * @param storage_path Path to the backend storage file/device/partition/...
  * @param state_name Name of the state
  * @param of_path Path in the devicetree
@@ -155,7 +204,8 @@ int state_backend_init(struct state_backend *backend, struct device_d *dev,
 {
 	int ret;
 
-	ret = state_format_init(backend, dev, backend_format, node, state_name);
+	ret = state_format_init(backend, dev, backend_format, node, state_name,
+				stridesize);
 	if (ret)
 		return ret;
 
@@ -89,6 +89,7 @@ static int state_backend_bucket_cache_write(struct state_backend_storage_bucket
 {
 	struct state_backend_storage_bucket_cache *cache =
 			get_bucket_cache(bucket);
+	ssize_t keep = 0;
 	int ret;
 
 	if (!cache->force_write) {
@@ -97,11 +98,20 @@ static int state_backend_bucket_cache_write(struct state_backend_storage_bucket
 
 		if (cache->data_len == len && !memcmp(cache->data, buf, len))
 			return 0;
+
+		/* the storage holds the cached data, only write what differs */
+		if (cache->data && cache->raw->write_partial)
+			while (keep < min(len, cache->data_len) &&
+			       buf[keep] == cache->data[keep])
+				keep++;
 	}
 
 	state_backend_bucket_cache_drop(cache);
 
-	ret = cache->raw->write(cache->raw, buf, len);
+	if (keep)
+		ret = cache->raw->write_partial(cache->raw, buf, len, keep);
+	else
+		ret = cache->raw->write(cache->raw, buf, len);
 	if (ret)
 		return ret;
 
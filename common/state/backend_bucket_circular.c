@@ -35,6 +35,7 @@ struct state_backend_storage_bucket_circular {
 
 	off_t write_area; /* Start of the write area (relative offset) */
 	uint32_t last_written_length; /* Size of the data written in the storage */
+	unsigned int init_reads; /* Pages read to find the write area */
 
 #ifdef __BAREBOX__
 	struct mtd_info *mtd; /* mtd info (used for io in Barebox)*/
@@ -362,57 +363,215 @@ out_free:
 	return ret;
 }
 
+/*
+ * Read page @page of the bucket into @buf. Returns 1 if it is free, 0 if it
+ * has been written, -errno otherwise. Pages with ECC errors count as written.
+ */
+static int circular_page_is_free(struct state_backend_storage_bucket_circular *circ,
+				 uint8_t *buf, int page)
+{
+	int ret;
+
+	circ->init_reads++;
+
+	ret = state_mtd_peb_read(circ, buf, page * circ->writesize,
+				 circ->writesize);
+	if (ret && ret != -EUCLEAN)
+		return ret;
+
+	return mtd_buf_all_ff(buf, circ->writesize);
+}
+
+/*
+ * Check that @len bytes from @offset are erased. They are read with a
+ * single request. Returns 1 if they are, 0 if not, -errno otherwise.
+ */
+static int circular_area_is_free(struct state_backend_storage_bucket_circular *circ,
+				 int offset, int len)
+{
+	uint8_t *buf;
+	int ret;
+
+	circ->init_reads++;
+
+	buf = xmalloc(len);
+
+	ret = state_mtd_peb_read(circ, buf, offset, len);
+	if (!ret)
+		ret = mtd_buf_all_ff(buf, len);
+	else if (ret == -EUCLEAN)
+		ret = 0;
+
+	free(buf);
+
+	return ret;
+}
+
+static uint32_t circular_page_written_length(struct state_backend_storage_bucket_circular *circ,
+					     uint8_t *buf)
+{
+	struct state_backend_storage_bucket_circular_meta *meta;
+
+	meta = (struct state_backend_storage_bucket_circular_meta *)
+			(buf + circ->writesize - sizeof(*meta));
+
+	if (meta->magic != circular_magic)
+		return 0;
+
+	return meta->written_length;
+}
+
+/*
+ * Find the number of written pages by reading all pages from the end of the
+ * eraseblock.
+ */
+static int circular_scan_linear(struct state_backend_storage_bucket_circular *circ,
+				uint8_t *buf, int *pages, uint32_t *written_length)
+{
+	int page, ret;
+
+	for (page = circ->max_size / circ->writesize - 1; page >= 0; page--) {
+		ret = circular_page_is_free(circ, buf, page);
+		if (ret < 0)
+			return ret;
+		if (!ret) {
+			*written_length = circular_page_written_length(circ, buf);
+			break;
+		}
+	}
+
+	*pages = page + 1;
+
+	return 0;
+}
+
+/*
+ * Find the number of written pages with a binary search. Writes are
+ * appended, so the eraseblock is written up to some page and free behind it.
+ * The first page of a state is never free, it holds the header of the
+ * format, and the last one holds the meta data. A written page which holds
+ * the meta data followed by a free one is therefore the end of the written
+ * area.
+ *
+ * State data may contain pages which are all 0xff though, so the search can
+ * stop on such a page in the middle of a later state. All states written to
+ * the eraseblock have the size of the last one found, so the pages a state
+ * of this size could end in behind the free page are read back and must be
+ * erased, or the next write would go to pages which are already written.
+ * Returns -EAGAIN if the end could not be determined this way.
+ */
+static int circular_scan_bisect(struct state_backend_storage_bucket_circular *circ,
+				uint8_t *buf, uint8_t *last, int *pages,
+				uint32_t *written_length)
+{
+	int lo = 0, hi = circ->max_size / circ->writesize - 1;
+	int end = hi, ret, n;
+
+	/* full */
+	ret = circular_page_is_free(circ, last, hi);
+	if (ret < 0)
+		return ret;
+	if (!ret) {
+		*written_length = circular_page_written_length(circ, last);
+		*pages = hi + 1;
+		return 0;
+	}
+
+	/* empty */
+	ret = circular_page_is_free(circ, last, lo);
+	if (ret < 0)
+		return ret;
+	if (ret) {
+		*pages = 0;
+		return 0;
+	}
+
+	/* page lo is written and page hi is free */
+	while (hi - lo > 1) {
+		int mid = lo + (hi - lo) / 2;
+
+		ret = circular_page_is_free(circ, buf, mid);
+		if (ret < 0)
+			return ret;
+
+		if (ret) {
+			hi = mid;
+		} else {
+			lo = mid;
+			swap(buf, last);
+		}
+	}
+
+	*written_length = circular_page_written_length(circ, last);
+	if (!*written_length || !IS_ALIGNED(*written_length, circ->writesize))
+		return -EAGAIN;
+
+	/* the state ending in page lo must fit in front of it */
+	n = *written_length / circ->writesize;
+	if (n > lo + 1)
+		return -EAGAIN;
+
+	/* pages hi and end are known to be free */
+	n = min(n - 1, end - hi - 1);
+	if (n > 0) {
+		ret = circular_area_is_free(circ, (hi + 1) * circ->writesize,
+					    n * circ->writesize);
+		if (ret < 0)
+			return ret;
+		if (!ret)
+			return -EAGAIN;
+	}
+
+	*pages = lo + 1;
+
+	return 0;
+}
+
 /**
  * state_backend_bucket_circular_init - Initialize circular bucket
  * @param bucket
  * @return 0 on success, -errno otherwise
  *
- * This function searches for the beginning of the written area from the end of
- * the MTD device. This way it knows where the data ends and where the free area
- * starts.
+ * This function searches for the end of the written area in the eraseblock.
+ * This way it knows where the data ends and where the free area starts. A
+ * binary search needs a few page reads and one read of at most a state's
+ * size behind the end it found. If it fails to find the end, e.g. for the old on-storage
+ * format, after ECC errors or when the free area is not erased, all pages are
+ * read from the end of the eraseblock.
  */
 static int state_backend_bucket_circular_init(
 		struct state_backend_storage_bucket *bucket)
 {
 	struct state_backend_storage_bucket_circular *circ =
 	    get_bucket_circular(bucket);
-	int sub_offset;
 	uint32_t written_length = 0;
-	uint8_t *buf;
+	uint8_t *buf, *last;
+	int pages = 0, ret;
 
 	buf = xmalloc(circ->writesize);
-	if (!buf)
-		return -ENOMEM;
+	last = xmalloc(circ->writesize);
 
-	for (sub_offset = circ->max_size - circ->writesize; sub_offset >= 0;
-	     sub_offset -= circ->writesize) {
-		int ret;
+	circ->init_reads = 0;
 
-		ret = state_mtd_peb_read(circ, buf, sub_offset,
-					 circ->writesize);
-		if (ret && ret != -EUCLEAN)
-			return ret;
-
-		ret = mtd_buf_all_ff(buf, circ->writesize);
-		if (!ret) {
-			struct state_backend_storage_bucket_circular_meta *meta;
-
-			meta = (struct state_backend_storage_bucket_circular_meta *)
-					(buf + circ->writesize - sizeof(*meta));
+	ret = circular_scan_bisect(circ, buf, last, &pages, &written_length);
+	if (ret == -EAGAIN) {
+		dev_dbg(circ->dev, "PEB %u: no end of written area found after %u reads, scanning\n",
+			circ->eraseblock, circ->init_reads);
+		written_length = 0;
+		ret = circular_scan_linear(circ, buf, &pages, &written_length);
+	}
 
-			if (meta->magic != circular_magic)
-				written_length = 0;
-			else
-				written_length = meta->written_length;
+	free(last);
+	free(buf);
 
-			break;
-		}
-	}
+	if (ret)
+		return ret;
 
-	circ->write_area = sub_offset + circ->writesize;
+	circ->write_area = pages * circ->writesize;
 	circ->last_written_length = written_length;
 
-	free(buf);
+	dev_dbg(circ->dev, "PEB %u: write area at %ld after %u page reads\n",
+		circ->eraseblock, circ->write_area, circ->init_reads);
 
 	return 0;
 }
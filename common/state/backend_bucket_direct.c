@@ -140,6 +140,58 @@ static int state_backend_bucket_direct_write(struct state_backend_storage_bucket
 	return 0;
 }
 
+/*
+ * Write the new data behind the first keep bytes first and the meta data last.
+ * When data is appended, the old length stays valid until the new data is
+ * complete.
+ */
+static int state_backend_bucket_direct_write_partial(struct state_backend_storage_bucket
+						     *bucket, const uint8_t * buf,
+						     ssize_t len, ssize_t keep)
+{
+	struct state_backend_storage_bucket_direct *direct =
+	    get_bucket_direct(bucket);
+	int ret;
+	struct state_backend_storage_bucket_direct_meta meta;
+
+	if (direct->max_size && len > direct->max_size)
+		return -E2BIG;
+
+	ret = lseek(direct->fd, direct->offset + sizeof(meta) + keep, SEEK_SET);
+	if (ret < 0) {
+		dev_err(direct->dev, "Failed to seek file, %d\n", ret);
+		return ret;
+	}
+
+	ret = write_full(direct->fd, buf + keep, len - keep);
+	if (ret < 0) {
+		dev_err(direct->dev, "Failed to write file, %d\n", ret);
+		return ret;
+	}
+
+	ret = lseek(direct->fd, direct->offset, SEEK_SET);
+	if (ret < 0) {
+		dev_err(direct->dev, "Failed to seek file, %d\n", ret);
+		return ret;
+	}
+
+	meta.magic = direct_magic;
+	meta.written_length = len;
+	ret = write_full(direct->fd, &meta, sizeof(meta));
+	if (ret < 0) {
+		dev_err(direct->dev, "Failed to write metadata to file, %d\n", ret);
+		return ret;
+	}
+
+	ret = flush(direct->fd);
+	if (ret < 0) {
+		dev_err(direct->dev, "Failed to flush file, %d\n", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
 static void state_backend_bucket_direct_free(struct
 					     state_backend_storage_bucket
 					     *bucket)
@@ -173,6 +225,7 @@ int state_backend_bucket_direct_create(struct device_d *dev, const char *path,
 
 	direct->bucket.read = state_backend_bucket_direct_read;
 	direct->bucket.write = state_backend_bucket_direct_write;
+	direct->bucket.write_partial = state_backend_bucket_direct_write_partial;
 	direct->bucket.free = state_backend_bucket_direct_free;
 	*bucket = &direct->bucket;
 
@@ -0,0 +1,372 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+/*
+ * The journal format stores a snapshot of the variables like the raw format,
+ * followed by a journal of changes. Each save appends a record with the
+ * changed variables to the journal, so a save only adds a few bytes behind
+ * the data already stored. When the journal grows larger than the snapshot
+ * or the data doesn't fit into a copy on the storage anymore, a new snapshot
+ * without journal is written.
+ *
+ * Layout: header, snapshot data, records. Each record is a struct
+ * backend_journal_record followed by len bytes of data which replace the
+ * data at offset start. The journal ends at the first invalid record, so a
+ * partially written record is ignored.
+ *
+ * The CRC of a record is seeded with the CRC of the header, which covers a
+ * generation number incremented with each snapshot. When a shorter
+ * snapshot is written over a longer journal, the records of the old
+ * journal behind it are therefore invalid, even if the length of the
+ * written data hasn't been updated yet.
+ */
+
+#include <common.h>
+#include <linux/kernel.h>
+#include <malloc.h>
+#include <crc.h>
+#include <of.h>
+
+#include "state.h"
+
+#define JOURNAL_VERSION		1
+
+struct state_backend_format_journal {
+	struct state_backend_format format;
+
+	uint8_t *blob; /* last packed or unpacked data */
+	ssize_t blob_len;
+	uint8_t *values; /* snapshot with the journal applied */
+	unsigned int data_len;
+	ssize_t max_len; /* size of a copy on the storage, 0 if unknown */
+
+	/* For outputs */
+	struct device_d *dev;
+};
+
+struct __attribute__((__packed__)) backend_journal_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t data_len;
+	uint32_t data_crc;
+	uint32_t generation;
+	uint32_t header_crc;
+};
+
+struct __attribute__((__packed__)) backend_journal_record {
+	uint16_t start;
+	uint16_t len;
+	uint32_t crc; /* over start, len and the data, seeded with header_crc */
+};
+
+static inline struct state_backend_format_journal *get_format_journal(
+		struct state_backend_format *format)
+{
+	return container_of(format, struct state_backend_format_journal,
+			    format);
+}
+
+static uint32_t journal_record_crc(const struct backend_journal_header *header,
+				   const struct backend_journal_record *rec,
+				   const uint8_t *data)
+{
+	uint32_t crc;
+
+	crc = crc32(header->header_crc, rec,
+		    offsetof(struct backend_journal_record, crc));
+
+	return crc32(crc, data, rec->len);
+}
+
+/*
+ * Apply the journal records of buf to values. Returns the length of the
+ * valid data in buf.
+ */
+static ssize_t journal_replay(const uint8_t *buf, ssize_t len,
+			      uint8_t *values, unsigned int data_len)
+{
+	const struct backend_journal_header *header =
+		(const struct backend_journal_header *)buf;
+	const struct backend_journal_record *rec;
+	ssize_t pos = sizeof(*header) + data_len;
+
+	while (pos + (ssize_t)sizeof(*rec) <= len) {
+		const uint8_t *data;
+
+		rec = (const struct backend_journal_record *)(buf + pos);
+		data = buf + pos + sizeof(*rec);
+
+		if (!rec->len || rec->start + rec->len > data_len ||
+		    pos + sizeof(*rec) + rec->len > len ||
+		    journal_record_crc(header, rec, data) != rec->crc)
+			break;
+
+		if (values)
+			memcpy(values + rec->start, data, rec->len);
+
+		pos += sizeof(*rec) + rec->len;
+	}
+
+	return pos;
+}
+
+static int backend_format_journal_verify(struct state_backend_format *format,
+					 uint32_t magic, const uint8_t *buf,
+					 ssize_t len)
+{
+	struct state_backend_format_journal *journal =
+		get_format_journal(format);
+	const struct backend_journal_header *header;
+	uint32_t crc;
+
+	if (len < sizeof(*header)) {
+		dev_err(journal->dev, "Error, buffer length (%zd) is shorter than the journal header\n",
+			len);
+		return -EINVAL;
+	}
+
+	header = (const struct backend_journal_header *)buf;
+	crc = crc32(0, header, sizeof(*header) - sizeof(uint32_t));
+	if (crc != header->header_crc) {
+		dev_err(journal->dev, "Error, invalid header crc in journal format, calculated 0x%08x, found 0x%08x\n",
+			crc, header->header_crc);
+		return -EINVAL;
+	}
+
+	if (magic && magic != header->magic) {
+		dev_err(journal->dev, "Error, invalid magic in journal format 0x%08x, should be 0x%08x\n",
+			header->magic, magic);
+		return -EINVAL;
+	}
+
+	if (header->version != JOURNAL_VERSION) {
+		dev_err(journal->dev, "Error, unsupported journal format version %u\n",
+			header->version);
+		return -EINVAL;
+	}
+
+	if (sizeof(*header) + header->data_len > len) {
+		dev_err(journal->dev, "Error, invalid data_len %u in header, have data of len %zd\n",
+			header->data_len, len);
+		return -EINVAL;
+	}
+
+	crc = crc32(0, buf + sizeof(*header), header->data_len);
+	if (crc != header->data_crc) {
+		dev_err(journal->dev, "invalid data crc, calculated 0x%08x, found 0x%08x\n",
+			crc, header->data_crc);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int backend_format_journal_unpack(struct state_backend_format *format,
+					 struct state *state,
+					 const uint8_t *buf, ssize_t len)
+{
+	struct state_backend_format_journal *journal =
+		get_format_journal(format);
+	const struct backend_journal_header *header;
+	struct state_variable *sv;
+	uint8_t *values;
+
+	header = (const struct backend_journal_header *)buf;
+
+	values = xmemdup(buf + sizeof(*header), header->data_len);
+	len = journal_replay(buf, len, values, header->data_len);
+
+	list_for_each_entry(sv, &state->variables, list) {
+		if (sv->start + sv->size > header->data_len) {
+			dev_err(journal->dev, "State variable ends behind valid data, %s\n",
+				sv->name);
+			continue;
+		}
+		memcpy(sv->raw, values + sv->start, sv->size);
+	}
+
+	free(journal->blob);
+	free(journal->values);
+	journal->blob = xmemdup(buf, len);
+	journal->blob_len = len;
+	journal->values = values;
+	journal->data_len = header->data_len;
+
+	return 0;
+}
+
+/*
+ * Start over with a snapshot of values and an empty journal
+ */
+static void journal_compact(struct state_backend_format_journal *journal,
+			    struct state *state, uint8_t *values,
+			    unsigned int data_len)
+{
+	struct backend_journal_header *header;
+	uint32_t generation = 0;
+
+	if (journal->blob) {
+		header = (struct backend_journal_header *)journal->blob;
+		generation = header->generation + 1;
+	}
+
+	free(journal->blob);
+	journal->blob_len = sizeof(*header) + data_len;
+	journal->blob = xzalloc(journal->blob_len);
+
+	header = (struct backend_journal_header *)journal->blob;
+	memcpy(journal->blob + sizeof(*header), values, data_len);
+
+	header->magic = state->magic;
+	header->version = JOURNAL_VERSION;
+	header->data_len = data_len;
+	header->data_crc = crc32(0, values, data_len);
+	header->generation = generation;
+	header->header_crc = crc32(0, header,
+				   sizeof(*header) - sizeof(uint32_t));
+
+	free(journal->values);
+	journal->values = values;
+	journal->data_len = data_len;
+}
+
+static int backend_format_journal_pack(struct state_backend_format *format,
+				       struct state *state, uint8_t **buf_out,
+				       ssize_t *len_out)
+{
+	struct state_backend_format_journal *journal =
+		get_format_journal(format);
+	struct backend_journal_header *header;
+	struct backend_journal_record *rec = NULL;
+	struct state_variable *sv;
+	unsigned int data_len, nr_vars = 0, end = 0;
+	ssize_t journal_len, len;
+	uint8_t *values, *buf;
+
+	sv = list_last_entry(&state->variables, struct state_variable, list);
+	data_len = sv->start + sv->size;
+
+	/* data_len and the offsets in the records are 16 bit */
+	if (data_len > U16_MAX) {
+		dev_err(journal->dev, "State data of %u bytes too large for the journal format\n",
+			data_len);
+		return -EINVAL;
+	}
+
+	values = xzalloc(data_len);
+	list_for_each_entry(sv, &state->variables, list) {
+		memcpy(values + sv->start, sv->raw, sv->size);
+		nr_vars++;
+	}
+
+	header = (struct backend_journal_header *)journal->blob;
+	if (!journal->blob || journal->data_len != data_len ||
+	    header->magic != state->magic) {
+		journal_compact(journal, state, values, data_len);
+		goto out;
+	}
+
+	/*
+	 * Append a record for each run of changed variables. Records are
+	 * built in a copy of the blob large enough for every variable.
+	 */
+	buf = xmalloc(journal->blob_len + data_len +
+		      nr_vars * sizeof(*rec));
+	memcpy(buf, journal->blob, journal->blob_len);
+	len = journal->blob_len;
+
+	list_for_each_entry(sv, &state->variables, list) {
+		if (!memcmp(values + sv->start, journal->values + sv->start,
+			    sv->size))
+			continue;
+
+		if (!rec || sv->start != end) {
+			if (rec)
+				rec->crc = journal_record_crc(header, rec,
+							      (uint8_t *)(rec + 1));
+			rec = (struct backend_journal_record *)(buf + len);
+			rec->start = sv->start;
+			rec->len = 0;
+			len += sizeof(*rec);
+		}
+
+		memcpy(buf + len, values + sv->start, sv->size);
+		rec->len += sv->size;
+		len += sv->size;
+		end = sv->start + sv->size;
+	}
+
+	if (rec)
+		rec->crc = journal_record_crc(header, rec, (uint8_t *)(rec + 1));
+
+	journal_len = len - sizeof(*header) - data_len;
+
+	if (!rec) {
+		free(buf);
+		free(values);
+	} else if (journal_len > sizeof(*header) + data_len ||
+		   (journal->max_len && len > journal->max_len)) {
+		dev_dbg(journal->dev, "Journal full, compacting\n");
+		free(buf);
+		journal_compact(journal, state, values, data_len);
+	} else {
+		free(journal->blob);
+		free(journal->values);
+		journal->blob = buf;
+		journal->blob_len = len;
+		journal->values = values;
+	}
+
+out:
+	*buf_out = xmemdup(journal->blob, journal->blob_len);
+	*len_out = journal->blob_len;
+
+	return 0;
+}
+
+static void backend_format_journal_free(struct state_backend_format *format)
+{
+	struct state_backend_format_journal *journal =
+		get_format_journal(format);
+
+	free(journal->blob);
+	free(journal->values);
+	free(journal);
+}
+
+int backend_format_journal_create(struct state_backend_format **format,
+				  struct device_node *node, ssize_t max_len,
+				  struct device_d *dev)
+{
+	struct state_backend_format_journal *journal;
+
+	if (of_find_property(node, "algo", NULL)) {
+		dev_err(dev, "algo is not supported by the journal format\n");
+		return -EINVAL;
+	}
+
+	journal = xzalloc(sizeof(*journal));
+	if (!journal)
+		return -ENOMEM;
+
+	journal->dev = dev;
+	journal->max_len = max_len;
+
+	journal->format.pack = backend_format_journal_pack;
+	journal->format.unpack = backend_format_journal_unpack;
+	journal->format.verify = backend_format_journal_verify;
+	journal->format.free = backend_format_journal_free;
+	journal->format.name = "journal";
+	*format = &journal->format;
+
+	return 0;
+}
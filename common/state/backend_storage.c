@@ -68,11 +68,14 @@ int state_storage_write(struct state_backend_storage *storage,
 	if (storage->readonly)
 		return 0;
 
+	storage->incomplete = false;
+
 	list_for_each_entry(bucket, &storage->buckets, bucket_list) {
 		ret = bucket_lazy_init(bucket);
 		if (ret) {
 			dev_warn(storage->dev, "Failed to init bucket/write state backend bucket, %d\n",
 				 ret);
+			storage->incomplete = true;
 			continue;
 		}
 
@@ -80,6 +83,7 @@ int state_storage_write(struct state_backend_storage *storage,
 		if (ret) {
 			dev_warn(storage->dev, "Failed to write state backend bucket, %d\n",
 				 ret);
+			storage->incomplete = true;
 		} else {
 			++copies_written;
 		}
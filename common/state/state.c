@@ -58,6 +58,9 @@ static struct state *state_new(const char *name)
 	state->save_on_shutdown = 1;
 	dev_add_param_bool(&state->dev, "save_on_shutdown", NULL, NULL,
 			   &state->save_on_shutdown, NULL);
+	state->deferred_save = IS_ENABLED(CONFIG_STATE_DEFERRED_SAVE);
+	dev_add_param_bool(&state->dev, "deferred_save", NULL, NULL,
+			   &state->deferred_save, NULL);
 
 	list_add_tail(&state->list, &state_list);
 
@@ -410,6 +413,7 @@ void state_release(struct state *state)
 	list_del(&state->list);
 	unregister_device(&state->dev);
 	state_backend_free(&state->backend);
+	free(state->packed);
 	free(state->of_path);
 	free(state);
 }
@@ -565,6 +569,14 @@ int state_get_name(const struct state *state, char const **name)
 	return 0;
 }
 
+/*
+ * Changes whenever a variable of the state is set or the state is loaded
+ */
+unsigned int state_get_generation(const struct state *state)
+{
+	return state->dev.param_generation;
+}
+
 void state_info(void)
 {
 	struct state *state;
@@ -582,12 +594,16 @@ void state_info(void)
 	}
 }
 
+/*
+ * Runs before an OS is started and before a reset, so deferred saves are
+ * written here.
+ */
 static void state_shutdown(void)
 {
 	struct state *state;
 
 	list_for_each_entry(state, &state_list, list) {
-		if (state->save_on_shutdown)
+		if (state->save_on_shutdown || state->save_pending)
 			state_save(state);
 	}
 }
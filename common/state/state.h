@@ -12,6 +12,9 @@ struct mtd_info_user;
  * @init Optional, initiates the given bucket
  * @write Required, writes the given data to the storage in any form. Returns 0
  * on success
+ * @write_partial Optional, like write, but the first keep bytes of the given
+ * data are already stored in the bucket by the last write. Only the remaining
+ * data needs to be written.
  * @read Required, reads the last successfully written data from the backend
  * storage. Returns 0 on success and allocates a matching memory area to buf.
  * len_hint can be a hint of the storage format how large the data to be read
@@ -23,6 +26,8 @@ struct state_backend_storage_bucket {
 	int (*init) (struct state_backend_storage_bucket * bucket);
 	int (*write) (struct state_backend_storage_bucket * bucket,
 		      const uint8_t * buf, ssize_t len);
+	int (*write_partial) (struct state_backend_storage_bucket * bucket,
+			      const uint8_t * buf, ssize_t len, ssize_t keep);
 	int (*read) (struct state_backend_storage_bucket * bucket,
 		     uint8_t ** buf, ssize_t * len_hint);
 	void (*free) (struct state_backend_storage_bucket * bucket);
@@ -75,6 +80,9 @@ struct state_backend_storage {
 	uint32_t stridesize;
 
 	bool readonly;
+
+	/* a bucket missed the last write, it may hold stale data */
+	bool incomplete;
 };
 
 /**
@@ -101,6 +109,12 @@ struct state {
 	struct list_head variables; /* Sorted list of variables */
 	unsigned int dirty;
 	unsigned int save_on_shutdown;
+	unsigned int deferred_save; /* state_save_deferred() only marks */
+	bool save_pending; /* deferred save not yet written */
+
+	/* packed data as last loaded or saved, to skip unchanged saves */
+	uint8_t *packed;
+	ssize_t packed_len;
 
 	struct state_backend backend;
 };
@@ -199,6 +213,9 @@ int backend_format_raw_create(struct state_backend_format **format,
 			      struct device_d *dev);
 int backend_format_dtb_create(struct state_backend_format **format,
 			      struct device_d *dev);
+int backend_format_journal_create(struct state_backend_format **format,
+				  struct device_node *node, ssize_t max_len,
+				  struct device_d *dev);
 int state_storage_init(struct state_backend_storage *storage,
 		       struct device_d *dev, const char *path,
 		       off_t offset, size_t max_size, uint32_t stridesize,
@@ -58,12 +58,14 @@ struct aiochannel *aiochannel_get(struct device_d *dev, int index)
         if (ret)
                 return ERR_PTR(ret);
 
+	of_device_ensure_probed(spec.np);
+
 	list_for_each_entry(aiodev, &aiodevices, list) {
 		if (aiodev->hwdev->device_node == spec.np)
 			goto found;
 	}
 
-	return ERR_PTR(-EPROBE_DEFER);
+	return ERR_PTR(device_defer_probe(spec.np));
 
 found:
 	if (spec.args_count)
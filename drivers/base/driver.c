@@ -36,6 +36,7 @@
 #include <linux/err.h>
 #include <complete.h>
 #include <pinctrl.h>
+#include <bootchart.h>
 
 LIST_HEAD(device_list);
 EXPORT_SYMBOL(device_list);
@@ -45,6 +46,7 @@ EXPORT_SYMBOL(driver_list);
 
 static LIST_HEAD(active);
 static LIST_HEAD(deferred);
+static LIST_HEAD(deferred_ready);
 
 struct device_d *get_device_by_name(const char *name)
 {
@@ -81,17 +83,75 @@ int get_free_deviceid(const char *name_template)
 	};
 }
 
+/* The device whose probe function is currently running */
+static struct device_d *probing_dev;
+
+int device_defer_probe(struct device_node *provider)
+{
+	if (probing_dev)
+		probing_dev->deferred_on = provider;
+
+	return -EPROBE_DEFER;
+}
+
+static bool device_waits_for(struct device_d *dev, struct device_d *provider)
+{
+	struct device_node *np;
+
+	/* unknown dependency, retry whenever another device probed */
+	if (!dev->deferred_on)
+		return true;
+
+	/* the resource may be described by a subnode of the provider */
+	for (np = dev->deferred_on; np; np = np->parent)
+		if (np == provider->device_node)
+			return true;
+
+	return false;
+}
+
+/*
+ * A device has been probed successfully. Queue the deferred devices
+ * waiting for it for another probe.
+ */
+static void device_wakeup_deferred(struct device_d *provider)
+{
+	struct device_d *dev, *tmp;
+
+	list_for_each_entry_safe(dev, tmp, &deferred, active)
+		if (device_waits_for(dev, provider))
+			list_move_tail(&dev->active, &deferred_ready);
+}
+
 int device_probe(struct device_d *dev)
 {
+	struct device_d *prev_probing_dev = probing_dev;
+	uint64_t start;
 	int ret;
 
 	pinctrl_select_state_default(dev);
 
 	list_add(&dev->active, &active);
 
+	dev->deferred_on = NULL;
+	probing_dev = dev;
+
+	start = bootchart_start();
 	ret = dev->bus->probe(dev);
-	if (ret == 0)
+
+	probing_dev = prev_probing_dev;
+
+	if (IS_ENABLED(CONFIG_BOOTCHART)) {
+		char *name = basprintf("%s (%s)", dev_name(dev),
+				       dev->driver->name);
+
+		bootchart_record(BOOTCHART_PROBE, name, NULL, ret, start);
+		free(name);
+	}
+	if (ret == 0) {
+		device_wakeup_deferred(dev);
 		return 0;
+	}
 
 	if (ret == -EPROBE_DEFER) {
 		list_del(&dev->active);
@@ -126,6 +186,9 @@ int device_detect_by_name(const char *__devname)
 		strsep(&str, ".");
 
 		dev = get_device_by_name(devname);
+		/* with deep probe the device may not have been created yet */
+		if (!dev && !of_device_ensure_probed_by_alias(devname))
+			dev = get_device_by_name(devname);
 		if (dev)
 			ret = device_detect(dev);
 
@@ -140,6 +203,235 @@ int device_detect_by_name(const char *__devname)
 	return ret;
 }
 
+static bool deep_probe;
+static bool deferred_probe_done;
+
+void deep_probe_enable(void)
+{
+	deep_probe = true;
+}
+
+bool deep_probe_is_enabled(void)
+{
+	return deep_probe;
+}
+
+/*
+ * With deep probe devices from the devicetree are only probed when
+ * requested. The barebox configuration nodes in /chosen are always probed.
+ */
+static bool device_may_probe(struct device_d *dev)
+{
+	struct device_node *np;
+
+	if (!deep_probe || !dev->device_node || dev->probe_requested)
+		return true;
+
+	for (np = dev->device_node; np->parent; np = np->parent)
+		if (!np->parent->parent && !strcmp(np->name, "chosen"))
+			return true;
+
+	return false;
+}
+
+/*
+ * Index of the compatibles of drivers and devicetree devices on buses
+ * matching with device_match(). When a devicetree device or a driver with
+ * a compatible table registers, only the candidates sharing a compatible
+ * (or, for drivers without devicetree support, the device name) are marked
+ * with a new generation count and then matched in the usual list order,
+ * instead of comparing against the match tables of all drivers or devices.
+ */
+#define MATCH_INDEX_SIZE	256
+
+struct match_index_entry {
+	struct match_index_entry *next;
+	const char *key;	/* compatible or name, NULL for devices */
+	void *obj;
+};
+
+static struct match_index_entry *driver_compat_index[MATCH_INDEX_SIZE];
+static struct match_index_entry *driver_name_index[MATCH_INDEX_SIZE];
+static struct match_index_entry *device_compat_index[MATCH_INDEX_SIZE];
+static unsigned int match_gen;
+
+static unsigned int match_index_hash(const char *str)
+{
+	unsigned int hash = 5381;
+
+	/* compatibles are compared case insensitive */
+	while (*str)
+		hash = hash * 33 + tolower(*str++);
+
+	return hash % MATCH_INDEX_SIZE;
+}
+
+static void match_index_add(struct match_index_entry **index, const char *hashkey,
+			    const char *key, void *obj)
+{
+	struct match_index_entry *e = xzalloc(sizeof(*e));
+	unsigned int hash = match_index_hash(hashkey);
+
+	e->key = key;
+	e->obj = obj;
+	e->next = index[hash];
+	index[hash] = e;
+}
+
+static bool bus_has_match_index(struct bus_type *bus)
+{
+	return IS_ENABLED(CONFIG_OFDEVICE) && bus && bus->match == device_match;
+}
+
+static bool device_is_indexed(struct device_d *dev)
+{
+	return dev->device_node && dev->match_index_node == dev->device_node;
+}
+
+static bool driver_is_indexed(struct driver_d *drv)
+{
+	return bus_has_match_index(drv->bus) && drv->of_compatible;
+}
+
+static void driver_index_add(struct driver_d *drv)
+{
+	const struct of_device_id *id;
+	const struct platform_device_id *pid;
+
+	if (!bus_has_match_index(drv->bus))
+		return;
+
+	if (drv->of_compatible) {
+		for (id = drv->of_compatible; id->compatible; id++)
+			match_index_add(driver_compat_index, id->compatible,
+					id->compatible, drv);
+	} else if (drv->id_table) {
+		for (pid = drv->id_table; pid->name; pid++)
+			match_index_add(driver_name_index, pid->name,
+					pid->name, drv);
+	} else {
+		match_index_add(driver_name_index, drv->name, drv->name, drv);
+	}
+}
+
+static void device_index_add(struct device_d *dev)
+{
+	struct property *prop;
+	const char *cp;
+
+	if (!bus_has_match_index(dev->bus) || !dev->device_node)
+		return;
+
+	prop = of_find_property(dev->device_node, "compatible", NULL);
+	for (cp = of_prop_next_string(prop, NULL); cp;
+	     cp = of_prop_next_string(prop, cp))
+		match_index_add(device_compat_index, cp, NULL, dev);
+
+	dev->match_index_node = dev->device_node;
+}
+
+static void device_index_remove(struct device_d *dev)
+{
+	struct match_index_entry **pe, *e;
+	int i;
+
+	if (!dev->match_index_node)
+		return;
+
+	for (i = 0; i < MATCH_INDEX_SIZE; i++) {
+		pe = &device_compat_index[i];
+		while ((e = *pe)) {
+			if (e->obj == dev) {
+				*pe = e->next;
+				free(e);
+			} else {
+				pe = &e->next;
+			}
+		}
+	}
+
+	dev->match_index_node = NULL;
+}
+
+/* Mark the drivers which may match an indexed device */
+static unsigned int driver_mark_candidates(struct device_d *dev)
+{
+	struct match_index_entry *e;
+	struct property *prop;
+	const char *cp;
+	struct driver_d *drv;
+
+	match_gen++;
+
+	prop = of_find_property(dev->device_node, "compatible", NULL);
+	for (cp = of_prop_next_string(prop, NULL); cp;
+	     cp = of_prop_next_string(prop, cp)) {
+		for (e = driver_compat_index[match_index_hash(cp)]; e; e = e->next) {
+			drv = e->obj;
+			if (!of_compat_cmp(e->key, cp, strlen(cp)))
+				drv->match_gen = match_gen;
+		}
+	}
+
+	for (e = driver_name_index[match_index_hash(dev->name)]; e; e = e->next) {
+		drv = e->obj;
+		if (!strcmp(e->key, dev->name))
+			drv->match_gen = match_gen;
+	}
+
+	return match_gen;
+}
+
+/* Mark the indexed devices which may match a driver with compatible table */
+static unsigned int device_mark_candidates(struct driver_d *drv)
+{
+	const struct of_device_id *id;
+	struct match_index_entry *e;
+	struct device_d *dev;
+
+	match_gen++;
+
+	for (id = drv->of_compatible; id->compatible; id++) {
+		for (e = device_compat_index[match_index_hash(id->compatible)]; e;
+		     e = e->next) {
+			dev = e->obj;
+			if (of_device_is_compatible(dev->device_node,
+						    id->compatible))
+				dev->match_gen = match_gen;
+		}
+	}
+
+	return match_gen;
+}
+
+static int match(struct driver_d *drv, struct device_d *dev);
+
+/*
+ * Match a device against the drivers of its bus, return 0 when a driver
+ * has been bound.
+ */
+static int device_match_drivers(struct device_d *dev)
+{
+	struct driver_d *drv;
+	bool indexed = device_is_indexed(dev);
+	unsigned int gen = 0;
+
+	if (indexed)
+		gen = driver_mark_candidates(dev);
+
+	bus_for_each_driver(dev->bus, drv) {
+		/* probes may have marked candidates for other devices */
+		if (indexed && gen != match_gen)
+			gen = driver_mark_candidates(dev);
+		if (indexed && drv->match_gen != gen)
+			continue;
+		if (!match(drv, dev))
+			return 0;
+	}
+
+	return -ENODEV;
+}
+
 static int match(struct driver_d *drv, struct device_d *dev)
 {
 	int ret;
@@ -147,6 +439,9 @@ static int match(struct driver_d *drv, struct device_d *dev)
 	if (dev->driver)
 		return -1;
 
+	if (!device_may_probe(dev))
+		return -1;
+
 	dev->driver = drv;
 
 	if (dev->bus->match(dev, drv))
@@ -163,8 +458,6 @@ err_out:
 
 int register_device(struct device_d *new_device)
 {
-	struct driver_d *drv;
-
 	if (new_device->id == DEVICE_ID_DYNAMIC) {
 		new_device->id = get_free_deviceid(new_device->name);
 	} else {
@@ -190,10 +483,8 @@ int register_device(struct device_d *new_device)
 
 		list_add_tail(&new_device->bus_list, &new_device->bus->device_list);
 
-		bus_for_each_driver(new_device->bus, drv) {
-			if (!match(drv, new_device))
-				break;
-		}
+		device_index_add(new_device);
+		device_match_drivers(new_device);
 	}
 
 	if (new_device->parent)
@@ -231,6 +522,8 @@ int unregister_device(struct device_d *old_dev)
 	list_del(&old_dev->bus_list);
 	list_del(&old_dev->active);
 
+	device_index_remove(old_dev);
+
 	/* remove device from parents child list */
 	if (old_dev->parent)
 		list_del(&old_dev->sibling);
@@ -240,43 +533,137 @@ int unregister_device(struct device_d *old_dev)
 EXPORT_SYMBOL(unregister_device);
 
 /*
- * Loop over list of deferred devices as long as at least one
- * device is successfully probed. Devices that again request
- * deferral are re-added to deferred list in device_probe().
- * For devices finally left in deferred list -EPROBE_DEFER
- * becomes a fatal error.
+ * Probe the deferred devices that have been queued because the provider
+ * they wait for has been probed.
  */
-static int device_probe_deferred(void)
+static bool device_probe_ready(void)
 {
-	struct device_d *dev, *tmp;
-	struct driver_d *drv;
-	bool success;
+	struct device_d *dev;
+	bool success = false;
 
-	do {
-		success = false;
+	while (!list_empty(&deferred_ready)) {
+		dev = list_first_entry(&deferred_ready, struct device_d, active);
+		list_del_init(&dev->active);
 
-		if (list_empty(&deferred))
-			break;
+		dev_dbg(dev, "re-probe device\n");
+		if (!device_match_drivers(dev))
+			success = true;
+	}
 
-		list_for_each_entry_safe(dev, tmp, &deferred, active) {
-			list_del(&dev->active);
-			INIT_LIST_HEAD(&dev->active);
+	return success;
+}
 
-			dev_dbg(dev, "re-probe device\n");
-			bus_for_each_driver(dev->bus, drv) {
-				if (match(drv, dev))
-					continue;
-				success = true;
-				break;
-			}
+/**
+ * device_ensure_probed - probe a device on demand
+ * @dev: the device
+ *
+ * Probes @dev if it has not been probed yet. This is needed for devices from
+ * the devicetree when deep probe is enabled, otherwise these are probed when
+ * their driver is registered. If there is no driver for @dev yet, it will be
+ * probed once the driver registers.
+ *
+ * Return: 0 if a driver is bound to @dev, -EPROBE_DEFER if its probe has been
+ * deferred or another negative error code otherwise.
+ */
+int device_ensure_probed(struct device_d *dev)
+{
+	if (dev->driver)
+		return 0;
+
+	dev->probe_requested = true;
+
+	/* already waiting on the deferred list */
+	if (!list_empty(&dev->active))
+		return -EPROBE_DEFER;
+
+	if (!dev->bus)
+		return -ENODEV;
+
+	device_match_drivers(dev);
+
+	/* late probes can satisfy devices deferred during the initcalls */
+	if (deferred_probe_done)
+		device_probe_ready();
+
+	if (dev->driver)
+		return 0;
+
+	return list_empty(&dev->active) ? -ENODEV : -EPROBE_DEFER;
+}
+EXPORT_SYMBOL(device_ensure_probed);
+
+static bool device_is_deferred(struct device_d *dev)
+{
+	struct device_d *d;
+
+	list_for_each_entry(d, &deferred, active)
+		if (d == dev)
+			return true;
+
+	return false;
+}
+
+/*
+ * Print what a permanently deferred device is waiting for, following the
+ * chain through providers which are deferred themselves.
+ */
+static void device_report_deferred(struct device_d *dev)
+{
+	struct device_node *np;
+	struct device_d *provider;
+	int depth = 0;
+
+	dev_err(dev, "probe permanently deferred\n");
+
+	while ((np = dev->deferred_on) && depth++ < 16) {
+		for (provider = NULL; np && !provider; np = np->parent)
+			provider = of_find_device_by_node(np);
+
+		if (!provider) {
+			dev_err(dev, "  waiting for %s, which has no device\n",
+				dev->deferred_on->full_name);
+			return;
+		}
+
+		if (!device_is_deferred(provider)) {
+			dev_err(dev, "  waiting for %s (%s), %s\n",
+				dev->deferred_on->full_name, dev_name(provider),
+				provider->driver ? "which did not register it" :
+				"which has no driver");
+			return;
 		}
+
+		dev_err(dev, "  waiting for %s (%s), which is deferred\n",
+			dev->deferred_on->full_name, dev_name(provider));
+
+		dev = provider;
+	}
+}
+
+/*
+ * Probe the deferred devices. Every deferred device is retried once,
+ * afterwards a device is only retried when the provider it waits for
+ * (see device_defer_probe()) or, if it's unknown, any other device has
+ * been probed successfully. Devices that again request deferral are
+ * re-added to deferred list in device_probe(). As the recorded provider
+ * may not be the only one missing, all devices are retried once more
+ * after a round that made progress. For devices finally left in deferred
+ * list -EPROBE_DEFER becomes a fatal error.
+ */
+static int device_probe_deferred(void)
+{
+	struct device_d *dev;
+	bool success;
+
+	do {
+		list_splice_init(&deferred, &deferred_ready);
+		success = device_probe_ready();
 	} while (success);
 
-	if (list_empty(&deferred))
-		return 0;
+	deferred_probe_done = true;
 
 	list_for_each_entry(dev, &deferred, active)
-		dev_err(dev, "probe permanently deferred\n");
+		device_report_deferred(dev);
 
 	return 0;
 }
@@ -297,6 +684,8 @@ struct driver_d *get_driver_by_name(const char *name)
 int register_driver(struct driver_d *drv)
 {
 	struct device_d *dev = NULL;
+	bool indexed = driver_is_indexed(drv);
+	unsigned int gen = 0;
 
 	debug("register_driver: %s\n", drv->name);
 
@@ -305,8 +694,21 @@ int register_driver(struct driver_d *drv)
 	list_add_tail(&drv->list, &driver_list);
 	list_add_tail(&drv->bus_list, &drv->bus->driver_list);
 
-	bus_for_each_device(drv->bus, dev)
+	driver_index_add(drv);
+
+	if (indexed)
+		gen = device_mark_candidates(drv);
+
+	bus_for_each_device(drv->bus, dev) {
+		/* unindexed devices are always tried */
+		if (indexed && device_is_indexed(dev)) {
+			if (gen != match_gen)
+				gen = device_mark_candidates(drv);
+			if (dev->match_gen != gen)
+				continue;
+		}
 		match(drv, dev);
+	}
 
 	return 0;
 }
@@ -19,6 +19,7 @@
 #include <malloc.h>
 #include <stringlist.h>
 #include <complete.h>
+#include <driver.h>
 #include <linux/clk.h>
 #include <linux/err.h>
 #include <linux/clk/clk-conf.h>
@@ -441,6 +442,8 @@ struct clk *of_clk_get_from_provider(struct of_phandle_args *clkspec)
 	struct of_clk_provider *provider;
 	struct clk *clk = ERR_PTR(-EPROBE_DEFER);
 
+	of_device_ensure_probed(clkspec->np);
+
 	/* Check if we have such a provider in our array */
 	list_for_each_entry(provider, &of_clk_providers, link) {
 		if (provider->node == clkspec->np)
@@ -449,6 +452,9 @@ struct clk *of_clk_get_from_provider(struct of_phandle_args *clkspec)
 			break;
 	}
 
+	if (PTR_ERR(clk) == -EPROBE_DEFER)
+		device_defer_probe(clkspec->np);
+
 	return clk;
 }
 
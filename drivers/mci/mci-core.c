@@ -36,6 +36,7 @@
 #include <disks.h>
 #include <of.h>
 #include <linux/err.h>
+#include <poller.h>
 
 #define MAX_BUFFER_NUMBER 0xffffffff
 
@@ -247,18 +248,18 @@ static int mci_go_idle(struct mci *mci)
 }
 
 /**
- * FIXME
+ * Issue a single SD "send operation condition" request
  * @param mci MCI instance
+ * @param cmd Command to use, holds the card's response afterwards
+ * @param busy Set to != 0 if the card is still busy powering up
  * @return Transaction status (0 on success)
  */
-static int sd_send_op_cond(struct mci *mci)
+static int sd_op_cond_once(struct mci *mci, struct mci_cmd *cmd,
+		unsigned *busy)
 {
 	struct mci_host *host = mci->host;
-	struct mci_cmd cmd;
-	int timeout = 1000;
 	int err;
 	unsigned voltages;
-	unsigned busy;
 	unsigned arg;
 
 	/*
@@ -270,50 +271,55 @@ static int sd_send_op_cond(struct mci *mci)
 	 */
 	voltages = host->voltages & 0xff8000;
 
-	do {
-		mci_setup_cmd(&cmd, MMC_CMD_APP_CMD, 0, MMC_RSP_R1);
-		err = mci_send_cmd(mci, &cmd, NULL);
-		if (err) {
-			dev_dbg(&mci->dev, "Preparing SD for operating conditions failed: %d\n", err);
-			return err;
-		}
+	mci_setup_cmd(cmd, MMC_CMD_APP_CMD, 0, MMC_RSP_R1);
+	err = mci_send_cmd(mci, cmd, NULL);
+	if (err) {
+		dev_dbg(&mci->dev, "Preparing SD for operating conditions failed: %d\n", err);
+		return err;
+	}
 
-		arg = mmc_host_is_spi(host) ? 0 : voltages;
+	arg = mmc_host_is_spi(host) ? 0 : voltages;
 
-		if (mci->version == SD_VERSION_2)
-			arg |= OCR_HCS;
+	if (mci->version == SD_VERSION_2)
+		arg |= OCR_HCS;
 
-		mci_setup_cmd(&cmd, SD_CMD_APP_SEND_OP_COND, arg, MMC_RSP_R3);
-		err = mci_send_cmd(mci, &cmd, NULL);
-		if (err) {
-			dev_dbg(&mci->dev, "SD operation condition set failed: %d\n", err);
-			return err;
-		}
-		udelay(1000);
+	mci_setup_cmd(cmd, SD_CMD_APP_SEND_OP_COND, arg, MMC_RSP_R3);
+	err = mci_send_cmd(mci, cmd, NULL);
+	if (err) {
+		dev_dbg(&mci->dev, "SD operation condition set failed: %d\n", err);
+		return err;
+	}
 
-		if (mmc_host_is_spi(host))
-			busy = cmd.response[0] & R1_SPI_IDLE;
-		else
-			busy = !(cmd.response[0] & OCR_BUSY);
+	if (mmc_host_is_spi(host))
+		*busy = cmd->response[0] & R1_SPI_IDLE;
+	else
+		*busy = !(cmd->response[0] & OCR_BUSY);
 
-	} while (busy && timeout--);
+	return 0;
+}
 
-	if (timeout <= 0) {
-		dev_dbg(&mci->dev, "SD operation condition set timed out\n");
-		return -ENODEV;
-	}
+/**
+ * Evaluate the operation conditions of a powered up SD card
+ * @param mci MCI instance
+ * @param cmd Command holding the response of the last op cond request
+ * @return Transaction status (0 on success)
+ */
+static int sd_op_cond_finish(struct mci *mci, struct mci_cmd *cmd)
+{
+	struct mci_host *host = mci->host;
+	int err;
 
 	if (mci->version != SD_VERSION_2)
 		mci->version = SD_VERSION_1_0;
 
 	if (mmc_host_is_spi(host)) { /* read OCR for spi */
-		mci_setup_cmd(&cmd, MMC_CMD_SPI_READ_OCR, 0, MMC_RSP_R3);
-		err = mci_send_cmd(mci, &cmd, NULL);
+		mci_setup_cmd(cmd, MMC_CMD_SPI_READ_OCR, 0, MMC_RSP_R3);
+		err = mci_send_cmd(mci, cmd, NULL);
 		if (err)
 			return err;
 	}
 
-	mci->ocr = cmd.response[0];
+	mci->ocr = cmd->response[0];
 
 	mci->high_capacity = ((mci->ocr & OCR_HCS) == OCR_HCS);
 	mci->rca = 0;
@@ -321,6 +327,73 @@ static int sd_send_op_cond(struct mci *mci)
 	return 0;
 }
 
+/**
+ * FIXME
+ * @param mci MCI instance
+ * @return Transaction status (0 on success)
+ */
+static int sd_send_op_cond(struct mci *mci)
+{
+	struct mci_cmd cmd;
+	int timeout = 1000;
+	int err;
+	unsigned busy;
+
+	do {
+		err = sd_op_cond_once(mci, &cmd, &busy);
+		if (err)
+			return err;
+		udelay(1000);
+	} while (busy && timeout--);
+
+	if (timeout <= 0) {
+		dev_dbg(&mci->dev, "SD operation condition set timed out\n");
+		return -ENODEV;
+	}
+
+	return sd_op_cond_finish(mci, &cmd);
+}
+
+/**
+ * Issue a single MMC "send operation condition" request
+ * @param mci MCI instance
+ * @param cmd Command to use, holds the card's response afterwards
+ * @param busy Set to != 0 if the card is still busy powering up
+ * @return Transaction status (0 on success)
+ */
+static int mmc_op_cond_once(struct mci *mci, struct mci_cmd *cmd,
+		unsigned *busy)
+{
+	struct mci_host *host = mci->host;
+	int err;
+
+	mci_setup_cmd(cmd, MMC_CMD_SEND_OP_COND, OCR_HCS |
+			host->voltages, MMC_RSP_R3);
+	err = mci_send_cmd(mci, cmd, NULL);
+	if (err) {
+		dev_dbg(&mci->dev, "Preparing MMC for operating conditions failed: %d\n", err);
+		return err;
+	}
+
+	*busy = !(cmd->response[0] & OCR_BUSY);
+
+	return 0;
+}
+
+/**
+ * Evaluate the operation conditions of a powered up MultiMediaCard
+ * @param mci MCI instance
+ * @param cmd Command holding the response of the last op cond request
+ */
+static void mmc_op_cond_finish(struct mci *mci, struct mci_cmd *cmd)
+{
+	mci->version = MMC_VERSION_UNKNOWN;
+	mci->ocr = cmd->response[0];
+
+	mci->high_capacity = ((mci->ocr & OCR_HCS) == OCR_HCS);
+	mci->rca = 0;
+}
+
 /**
  * Setup the operation conditions to a MultiMediaCard
  * @param mci MCI instance
@@ -328,37 +401,28 @@ static int sd_send_op_cond(struct mci *mci)
  */
 static int mmc_send_op_cond(struct mci *mci)
 {
-	struct mci_host *host = mci->host;
 	struct mci_cmd cmd;
 	int timeout = 1000;
 	int err;
+	unsigned busy;
 
 	/* Some cards seem to need this */
 	mci_go_idle(mci);
 
 	do {
-		mci_setup_cmd(&cmd, MMC_CMD_SEND_OP_COND, OCR_HCS |
-				host->voltages, MMC_RSP_R3);
-		err = mci_send_cmd(mci, &cmd, NULL);
-
-		if (err) {
-			dev_dbg(&mci->dev, "Preparing MMC for operating conditions failed: %d\n", err);
+		err = mmc_op_cond_once(mci, &cmd, &busy);
+		if (err)
 			return err;
-		}
 
 		udelay(1000);
-	} while (!(cmd.response[0] & OCR_BUSY) && timeout--);
+	} while (busy && timeout--);
 
 	if (timeout <= 0) {
 		dev_dbg(&mci->dev, "SD operation condition set timed out\n");
 		return -ENODEV;
 	}
 
-	mci->version = MMC_VERSION_UNKNOWN;
-	mci->ocr = cmd.response[0];
-
-	mci->high_capacity = ((mci->ocr & OCR_HCS) == OCR_HCS);
-	mci->rca = 0;
+	mmc_op_cond_finish(mci, &cmd);
 
 	return 0;
 }
@@ -1588,6 +1652,11 @@ static int mci_register_partition(struct mci_part *part)
 	 */
 	part->blk.dev = &mci->dev;
 	part->blk.ops = &mci_ops;
+	/* SDHCI compatible hosts have a 16 bit block count */
+	part->blk.max_blocks = 0xffff;
+	if (host->max_req_size)
+		part->blk.max_blocks = min_t(unsigned, part->blk.max_blocks,
+				host->max_req_size >> part->blk.blockbits);
 
 	rc = blockdevice_register(&part->blk);
 	if (rc != 0) {
@@ -1627,15 +1696,28 @@ static int mci_register_partition(struct mci_part *part)
 	return 0;
 }
 
+static void mci_card_power_off(struct mci *mci)
+{
+	struct mci_host *host = mci->host;
+
+	host->clock = 0;	/* disable the MCI clock */
+	mci_set_ios(mci);
+	if (!IS_ERR(host->supply))
+		regulator_disable(host->supply);
+}
+
 /**
- * Probe an MCI card at the given host interface
+ * Power up an MCI card and bring it into idle state
  * @param mci MCI device instance
  * @return 0 on success, negative values else
+ *
+ * This is the first step of probing a card, it is followed by
+ * negotiating the operation conditions and mci_card_probe_finish().
  */
-static int mci_card_probe(struct mci *mci)
+static int mci_card_probe_start(struct mci *mci)
 {
 	struct mci_host *host = mci->host;
-	int i, rc, disknum, ret;
+	int rc, ret;
 
 	if (host->card_present && !host->card_present(host) &&
 	    !host->non_removable) {
@@ -1671,16 +1753,25 @@ static int mci_card_probe(struct mci *mci)
 	}
 
 	/* Check if this card can handle the "SD Card Physical Layer Specification 2.0" */
-	rc = sd_send_if_cond(mci);
-	rc = sd_send_op_cond(mci);
-	if (rc && rc == -ETIMEDOUT) {
-		/* If the command timed out, we check for an MMC card */
-		dev_dbg(&mci->dev, "Card seems to be a MultiMediaCard\n");
-		rc = mmc_send_op_cond(mci);
-	}
+	sd_send_if_cond(mci);
 
-	if (rc)
-		goto on_error;
+	return 0;
+
+on_error:
+	mci_card_power_off(mci);
+
+	return rc;
+}
+
+/**
+ * Bring up an MCI card whose operation conditions are known
+ * @param mci MCI device instance
+ * @return 0 on success, negative values else
+ */
+static int mci_card_probe_finish(struct mci *mci)
+{
+	struct mci_host *host = mci->host;
+	int i, rc, disknum;
 
 	if (host->devname) {
 		mci->cdevname = strdup(host->devname);
@@ -1692,7 +1783,8 @@ static int mci_card_probe(struct mci *mci)
 	rc = mci_startup(mci);
 	if (rc) {
 		dev_dbg(&mci->dev, "Card's startup fails with %d\n", rc);
-		goto on_error;
+		mci_card_power_off(mci);
+		return rc;
 	}
 
 	dev_dbg(&mci->dev, "Card is up and running now, registering as a disk\n");
@@ -1714,17 +1806,138 @@ static int mci_card_probe(struct mci *mci)
 
 	dev_dbg(&mci->dev, "SD Card successfully added\n");
 
-on_error:
-	if (rc != 0) {
-		host->clock = 0;	/* disable the MCI clock */
-		mci_set_ios(mci);
-		if (!IS_ERR(host->supply))
-			regulator_disable(host->supply);
+	return 0;
+}
+
+/**
+ * Probe an MCI card at the given host interface
+ * @param mci MCI device instance
+ * @return 0 on success, negative values else
+ */
+static int mci_card_probe(struct mci *mci)
+{
+	int rc;
+
+	rc = mci_card_probe_start(mci);
+	if (rc)
+		return rc;
+
+	rc = sd_send_op_cond(mci);
+	if (rc && rc == -ETIMEDOUT) {
+		/* If the command timed out, we check for an MMC card */
+		dev_dbg(&mci->dev, "Card seems to be a MultiMediaCard\n");
+		rc = mmc_send_op_cond(mci);
+	}
+
+	if (rc) {
+		mci_card_power_off(mci);
+		return rc;
 	}
 
+	return mci_card_probe_finish(mci);
+}
+
+enum mci_probe_stage {
+	MCI_PROBE_START,
+	MCI_PROBE_SD_OP_COND,
+	MCI_PROBE_MMC_OP_COND,
+	MCI_PROBE_FINISH,
+};
+
+/**
+ * Background probe of an MCI card
+ * @param work The probe work of the MCI device instance
+ * @return > 0 when there is more to do, 0 when done, negative values on error
+ *
+ * Does the same as mci_card_probe(), but instead of busy waiting for the
+ * card to power up it polls the card once per stage and lets the rest
+ * of barebox run in between.
+ */
+static int mci_card_probe_step(struct poller_work *work)
+{
+	struct mci *mci = container_of(work, struct mci, probe_work);
+	struct mci_cmd *cmd = &mci->probe_cmd;
+	unsigned busy;
+	int rc;
+
+	switch (mci->probe_stage) {
+	case MCI_PROBE_START:
+		rc = mci_card_probe_start(mci);
+		if (rc)
+			return rc;
+
+		mci->probe_stage = MCI_PROBE_SD_OP_COND;
+		mci->probe_timeout = 1000;
+		return 1;
+	case MCI_PROBE_SD_OP_COND:
+		rc = sd_op_cond_once(mci, cmd, &busy);
+		if (rc == -ETIMEDOUT) {
+			/* If the command timed out, we check for an MMC card */
+			dev_dbg(&mci->dev, "Card seems to be a MultiMediaCard\n");
+			/* Some cards seem to need this */
+			mci_go_idle(mci);
+			mci->probe_stage = MCI_PROBE_MMC_OP_COND;
+			mci->probe_timeout = 1000;
+			return 1;
+		}
+		if (rc)
+			goto on_error;
+
+		if (!busy) {
+			rc = sd_op_cond_finish(mci, cmd);
+			if (rc)
+				goto on_error;
+			mci->probe_stage = MCI_PROBE_FINISH;
+			return 1;
+		}
+		break;
+	case MCI_PROBE_MMC_OP_COND:
+		rc = mmc_op_cond_once(mci, cmd, &busy);
+		if (rc)
+			goto on_error;
+
+		if (!busy) {
+			mmc_op_cond_finish(mci, cmd);
+			mci->probe_stage = MCI_PROBE_FINISH;
+			return 1;
+		}
+		break;
+	case MCI_PROBE_FINISH:
+	default:
+		return mci_card_probe_finish(mci);
+	}
+
+	/* card is still busy powering up */
+	if (mci->probe_timeout-- <= 0) {
+		dev_dbg(&mci->dev, "SD operation condition set timed out\n");
+		rc = -ENODEV;
+		goto on_error;
+	}
+
+	poller_work_delay(work, MSECOND);
+
+	return 1;
+
+on_error:
+	mci_card_power_off(mci);
+
 	return rc;
 }
 
+/**
+ * Wait for a card probe running in the background
+ * @param mci MCI device instance
+ * @return 0 if there was no background probe or it succeeded,
+ * negative values else
+ */
+static int mci_card_probe_wait(struct mci *mci)
+{
+	if (!poller_work_pending(&mci->probe_work))
+		return 0;
+
+	return poller_work_wait(&mci->probe_work);
+}
+
 /**
  * Trigger probing of an attached MCI card
  * @param mci_dev MCI device instance
@@ -1740,6 +1953,10 @@ static int mci_set_probe(struct param_d *param, void *priv)
 	if (!mci->probe)
 		return 0;
 
+	rc = mci_card_probe_wait(mci);
+	if (rc)
+		return rc;
+
 	rc = mci_check_if_already_initialized(mci);
 	if (rc != 0)
 		return 0;
@@ -1764,6 +1981,10 @@ int mci_detect_card(struct mci_host *host)
 {
 	int rc;
 
+	rc = mci_card_probe_wait(host->mci);
+	if (rc)
+		return rc;
+
 	rc = mci_check_if_already_initialized(host->mci);
 	if (rc != 0)
 		return 0;
@@ -1828,8 +2049,13 @@ int mci_register(struct mci_host *host)
 		mci->dev.info = mci_info;
 
 	/* if enabled, probe the attached card immediately */
-	if (IS_ENABLED(CONFIG_MCI_STARTUP))
+	if (IS_ENABLED(CONFIG_MCI_STARTUP_ASYNC)) {
+		mci->probe_stage = MCI_PROBE_START;
+		poller_work_start(&mci->probe_work, dev_name(&mci->dev),
+				mci_card_probe_step);
+	} else if (IS_ENABLED(CONFIG_MCI_STARTUP)) {
 		mci_card_probe(mci);
+	}
 
 	list_add_tail(&mci->list, &mci_list);
 
@@ -25,6 +25,7 @@
 #include <partition.h>
 #include <envfs.h>
 #include <fs.h>
+#include <globalvar.h>
 
 #define ENV_MNT_DIR "/boot"	/* If env on filesystem, where to mount */
 
@@ -99,6 +100,36 @@ static struct driver_d environment_driver = {
 	.of_compatible	= environment_dt_ids,
 };
 
+static int nv_journal_probe(struct device_d *dev)
+{
+	char *path;
+	int ret;
+
+	ret = of_find_path(dev->device_node, "device-path", &path, 0);
+	if (ret)
+		return ret;
+
+	dev_dbg(dev, "Setting nv journal path to %s\n", path);
+	nv_journal_set_path(path);
+	free(path);
+
+	return 0;
+}
+
+static struct of_device_id nv_journal_dt_ids[] = {
+	{
+		.compatible = "barebox,nv-journal",
+	}, {
+		/* sentinel */
+	}
+};
+
+static struct driver_d nv_journal_driver = {
+	.name		= "barebox-nv-journal",
+	.probe		= nv_journal_probe,
+	.of_compatible	= nv_journal_dt_ids,
+};
+
 static int barebox_of_driver_init(void)
 {
 	struct device_node *node;
@@ -115,6 +146,9 @@ static int barebox_of_driver_init(void)
 
 	platform_driver_register(&environment_driver);
 
+	if (IS_ENABLED(CONFIG_NVVAR_JOURNAL))
+		platform_driver_register(&nv_journal_driver);
+
 	return 0;
 }
 late_initcall(barebox_of_driver_init);
@@ -22,16 +22,23 @@
 #include <of_address.h>
 #include <errno.h>
 #include <malloc.h>
+#include <mem_cache.h>
 #include <init.h>
 #include <memory.h>
 #include <linux/sizes.h>
 #include <of_graph.h>
 #include <linux/ctype.h>
+#include <linux/log2.h>
 #include <linux/amba/bus.h>
 #include <linux/err.h>
 
 static struct device_node *root_node;
 
+static DEFINE_MEM_CACHE(of_node_cache, "device_node",
+			sizeof(struct device_node));
+static DEFINE_MEM_CACHE(of_property_cache, "property",
+			sizeof(struct property));
+
 /*
  * Iterate over all nodes of a tree. As a devicetree does not
  * have a dedicated list head, the start node (usually the root
@@ -178,7 +185,7 @@ void of_alias_scan(void)
 		    !of_prop_cmp(pp->name, "linux,phandle"))
 			continue;
 
-		np = of_find_node_by_path(pp->value);
+		np = of_find_node_by_path(of_property_get_value(pp));
 		if (!np)
 			continue;
 
@@ -192,11 +199,14 @@ void of_alias_scan(void)
 		if (id < 0)
 			continue;
 
-		/* Allocate an alias_prop with enough space for the stem */
-		ap = xzalloc(sizeof(*ap) + len + 1);
+		/*
+		 * Allocate an alias_prop with enough space for the stem and
+		 * a copy of the alias, the property may be replaced later.
+		 */
+		ap = xzalloc(sizeof(*ap) + len + 1 + strlen(start) + 1);
 		if (!ap)
 			continue;
-		ap->alias = start;
+		ap->alias = strcpy(ap->stem + len + 1, start);
 		of_alias_add(ap, np, id, start, len);
 	}
 }
@@ -250,13 +260,17 @@ EXPORT_SYMBOL_GPL(of_alias_get);
 struct device_node *of_find_node_by_alias(struct device_node *root, const char *alias)
 {
 	struct device_node *aliasnp;
+	struct alias_prop *app;
 	int ret;
 	const char *path;
 
 	if (!root)
 		root = root_node;
 
-	aliasnp = of_find_node_by_path_from(root, "/aliases");
+	if (root == root_node && of_aliases)
+		aliasnp = of_aliases;
+	else
+		aliasnp = of_find_node_by_path_from(root, "/aliases");
 	if (!aliasnp)
 		return NULL;
 
@@ -264,10 +278,86 @@ struct device_node *of_find_node_by_alias(struct device_node *root, const char *
 	if (ret)
 		return NULL;
 
+	/*
+	 * Aliases of the internal tree have already been resolved by
+	 * of_alias_scan(). Use them as long as the alias was not changed.
+	 */
+	if (root == root_node) {
+		list_for_each_entry(app, &aliases_lookup, link) {
+			if (!of_prop_cmp(app->alias, alias) &&
+			    !strcmp(app->np->full_name, path))
+				return app->np;
+		}
+	}
+
 	return of_find_node_by_path_from(root, path);
 }
 EXPORT_SYMBOL_GPL(of_find_node_by_alias);
 
+/*
+ * Lookup cache for the phandles of the internal tree. It is direct mapped
+ * and sized to the number of phandles in the tree when the tree is set.
+ * dtc numbers phandles sequentially, so there are few collisions. Entries
+ * are validated on lookup and dropped when their node is deleted, a miss
+ * falls back to walking the tree.
+ */
+static struct device_node **phandle_cache;
+static u32 phandle_cache_mask;
+static unsigned int phandle_lookups, phandle_walks;
+
+static void of_phandle_cache_populate(void)
+{
+	struct device_node *node;
+	unsigned int size = 0;
+
+	free(phandle_cache);
+	phandle_cache = NULL;
+
+	if (!root_node)
+		return;
+
+	of_tree_for_each_node_from(node, root_node) {
+		if (node->phandle)
+			size++;
+	}
+
+	size = roundup_pow_of_two(max(size, 16U));
+	phandle_cache = xzalloc(size * sizeof(*phandle_cache));
+	phandle_cache_mask = size - 1;
+
+	of_tree_for_each_node_from(node, root_node) {
+		struct device_node **slot;
+
+		if (!node->phandle)
+			continue;
+
+		slot = &phandle_cache[node->phandle & phandle_cache_mask];
+		if (!*slot)
+			*slot = node;
+	}
+}
+
+static void of_phandle_cache_remove(struct device_node *node)
+{
+	struct device_node **slot;
+
+	if (!phandle_cache || !node->phandle)
+		return;
+
+	slot = &phandle_cache[node->phandle & phandle_cache_mask];
+	if (*slot == node)
+		*slot = NULL;
+}
+
+/**
+ * of_print_lookup_stats - print statistics about devicetree lookups
+ */
+void of_print_lookup_stats(void)
+{
+	printf("phandle lookups: %u, tree walks: %u\n", phandle_lookups,
+	       phandle_walks);
+}
+
 /*
  * of_find_node_by_phandle_from - Find a node given a phandle from given
  * root node.
@@ -278,11 +368,24 @@ EXPORT_SYMBOL_GPL(of_find_node_by_alias);
 struct device_node *of_find_node_by_phandle_from(phandle phandle,
 		struct device_node *root)
 {
-	struct device_node *node;
+	struct device_node *node, **slot = NULL;
+
+	phandle_lookups++;
+
+	if (phandle_cache && (!root || root == root_node)) {
+		slot = &phandle_cache[phandle & phandle_cache_mask];
+		if (*slot && (*slot)->phandle == phandle)
+			return *slot;
+	}
+
+	phandle_walks++;
 
 	of_tree_for_each_node_from(node, root)
-		if (node->phandle == phandle)
+		if (node->phandle == phandle) {
+			if (slot)
+				*slot = node;
 			return node;
+		}
 
 	return NULL;
 }
@@ -338,6 +441,9 @@ phandle of_node_create_phandle(struct device_node *node)
 
 	node->phandle = p;
 
+	if (phandle_cache && root == root_node)
+		phandle_cache[p & phandle_cache_mask] = node;
+
 	p = cpu_to_be32(p);
 
 	of_set_property(node, "phandle", &p, sizeof(p), 1);
@@ -376,7 +482,7 @@ const void *of_get_property(const struct device_node *np, const char *name,
 {
 	struct property *pp = of_find_property(np, name, lenp);
 
-	return pp ? pp->value : NULL;
+	return pp ? of_property_get_value(pp) : NULL;
 }
 EXPORT_SYMBOL(of_get_property);
 
@@ -680,19 +786,21 @@ EXPORT_SYMBOL(of_match);
  * property data isn't large enough.
  *
  */
-static void *of_find_property_value_of_size(const struct device_node *np,
+static const void *of_find_property_value_of_size(const struct device_node *np,
 			const char *propname, u32 len)
 {
 	struct property *prop = of_find_property(np, propname, NULL);
+	const void *value;
 
 	if (!prop)
 		return ERR_PTR(-EINVAL);
-	if (!prop->value)
+	value = of_property_get_value(prop);
+	if (!value)
 		return ERR_PTR(-ENODATA);
 	if (len > prop->length)
 		return ERR_PTR(-EOVERFLOW);
 
-	return prop->value;
+	return value;
 }
 
 /**
@@ -871,11 +979,11 @@ int of_property_read_string(struct device_node *np, const char *propname,
 	struct property *prop = of_find_property(np, propname, NULL);
 	if (!prop)
 		return -EINVAL;
-	if (!prop->value)
+	if (!of_property_get_value(prop))
 		return -ENODATA;
-	if (strnlen(prop->value, prop->length) >= prop->length)
+	if (strnlen(of_property_get_value(prop), prop->length) >= prop->length)
 		return -EILSEQ;
-	*out_string = prop->value;
+	*out_string = of_property_get_value(prop);
 	return 0;
 }
 EXPORT_SYMBOL_GPL(of_property_read_string);
@@ -908,12 +1016,12 @@ int of_property_read_string_index(struct device_node *np, const char *propname,
 
 	if (!prop)
 		return -EINVAL;
-	if (!prop->value)
+	if (!of_property_get_value(prop))
 		return -ENODATA;
-	if (strnlen(prop->value, prop->length) >= prop->length)
+	if (strnlen(of_property_get_value(prop), prop->length) >= prop->length)
 		return -EILSEQ;
 
-	p = prop->value;
+	p = of_property_get_value(prop);
 
 	for (i = 0; total < prop->length; total += l, p += l) {
 		l = strlen(p) + 1;
@@ -945,10 +1053,10 @@ int of_property_match_string(struct device_node *np, const char *propname,
 
 	if (!prop)
 		return -EINVAL;
-	if (!prop->value)
+	if (!of_property_get_value(prop))
 		return -ENODATA;
 
-	p = prop->value;
+	p = of_property_get_value(prop);
 	end = p + prop->length;
 
 	for (i = 0; p < end; i++, p += l) {
@@ -984,12 +1092,12 @@ int of_property_count_strings(struct device_node *np, const char *propname)
 
 	if (!prop)
 		return -EINVAL;
-	if (!prop->value)
+	if (!of_property_get_value(prop))
 		return -ENODATA;
-	if (strnlen(prop->value, prop->length) >= prop->length)
+	if (strnlen(of_property_get_value(prop), prop->length) >= prop->length)
 		return -EILSEQ;
 
-	p = prop->value;
+	p = of_property_get_value(prop);
 
 	for (i = 0; total < prop->length; total += l, p += l, i++)
 		l = strlen(p) + 1;
@@ -1007,12 +1115,12 @@ const __be32 *of_prop_next_u32(struct property *prop, const __be32 *cur,
 		return NULL;
 
 	if (!cur) {
-		curv = prop->value;
+		curv = of_property_get_value(prop);
 		goto out_val;
 	}
 
 	curv += sizeof(*cur);
-	if (curv >= prop->value + prop->length)
+	if (curv >= of_property_get_value(prop) + prop->length)
 		return NULL;
 
 out_val:
@@ -1029,10 +1137,10 @@ const char *of_prop_next_string(struct property *prop, const char *cur)
 		return NULL;
 
 	if (!cur)
-		return prop->value;
+		return of_property_get_value(prop);
 
 	curv += strlen(cur) + 1;
-	if (curv >= prop->value + prop->length)
+	if (curv >= of_property_get_value(prop) + prop->length)
 		return NULL;
 
 	return curv;
@@ -1446,8 +1554,6 @@ EXPORT_SYMBOL(of_machine_is_compatible);
 struct device_node *of_find_node_by_path_from(struct device_node *from,
 					const char *path)
 {
-	char *slash, *p, *freep;
-
 	if (!from)
 		from = root_node;
 
@@ -1456,27 +1562,29 @@ struct device_node *of_find_node_by_path_from(struct device_node *from,
 
 	path++;
 
-	freep = p = xstrdup(path);
+	while (*path) {
+		struct device_node *child;
+		const char *slash;
+		size_t len;
 
-	while (1) {
-		if (!*p)
-			goto out;
+		slash = strchr(path, '/');
+		len = slash ? slash - path : strlen(path);
 
-		slash = strchr(p, '/');
-		if (slash)
-			*slash = 0;
+		for_each_child_of_node(from, child)
+			if (child->name && !strncasecmp(child->name, path, len) &&
+			    !child->name[len])
+				break;
 
-		from = of_get_child_by_name(from, p);
-		if (!from)
-			goto out;
+		if (&child->parent_list == &from->children)
+			return NULL;
+
+		from = child;
 
 		if (!slash)
-			goto out;
+			break;
 
-		p = slash + 1;
+		path = slash + 1;
 	}
-out:
-	free(freep);
 
 	return from;
 }
@@ -1574,6 +1682,7 @@ int of_set_root_node(struct device_node *node)
 	root_node = node;
 
 	of_alias_scan();
+	of_phandle_cache_populate();
 
 	return 0;
 }
@@ -1739,7 +1848,7 @@ void of_print_nodes(struct device_node *node, int indent)
 		printf("%s", p->name);
 		if (p->length) {
 			printf(" = ");
-			of_print_property(p->value, p->length);
+			of_print_property(of_property_get_value(p), p->length);
 		}
 		printf(";\n");
 	}
@@ -1757,7 +1866,7 @@ struct device_node *of_new_node(struct device_node *parent, const char *name)
 {
 	struct device_node *node;
 
-	node = xzalloc(sizeof(*node));
+	node = mem_cache_alloc(&of_node_cache);
 	node->parent = parent;
 	if (parent)
 		list_add_tail(&node->parent_list, &parent->children);
@@ -1784,10 +1893,10 @@ struct property *of_new_property(struct device_node *node, const char *name,
 {
 	struct property *prop;
 
-	prop = xzalloc(sizeof(*prop));
+	prop = mem_cache_alloc(&of_property_cache);
 	prop->name = strdup(name);
 	if (!prop->name) {
-		free(prop);
+		mem_cache_free(&of_property_cache, prop);
 		return NULL;
 	}
 
@@ -1802,6 +1911,37 @@ struct property *of_new_property(struct device_node *node, const char *name,
 	return prop;
 }
 
+/**
+ * of_new_property_const - create a property without copying its value
+ * @node - the node
+ * @name - the name of the property
+ * @data - the value for the property
+ * @len - the length of the properties value
+ *
+ * The property refers to @data, which must stay valid as long as the
+ * property exists. Code changing a property value replaces the property
+ * (see of_set_property()), so @data itself is never written to.
+ */
+struct property *of_new_property_const(struct device_node *node, const char *name,
+		const void *data, int len)
+{
+	struct property *prop;
+
+	prop = mem_cache_alloc(&of_property_cache);
+	prop->name = strdup(name);
+	if (!prop->name) {
+		mem_cache_free(&of_property_cache, prop);
+		return NULL;
+	}
+
+	prop->length = len;
+	prop->value_const = data;
+
+	list_add_tail(&prop->list, &node->properties);
+
+	return prop;
+}
+
 void of_delete_property(struct property *pp)
 {
 	if (!pp)
@@ -1811,7 +1951,7 @@ void of_delete_property(struct property *pp)
 
 	free(pp->name);
 	free(pp->value);
-	free(pp);
+	mem_cache_free(&of_property_cache, pp);
 }
 
 /**
@@ -1884,6 +2024,20 @@ const struct of_device_id of_default_bus_match_table[] = {
 	}
 };
 
+static struct device_node *of_get_stdout_node(void)
+{
+	const char *name;
+
+	name = of_get_property(of_chosen, "stdout-path", NULL);
+	if (!name)
+		name = of_get_property(of_chosen, "linux,stdout-path", NULL);
+
+	if (!name)
+		return NULL;
+
+	return of_find_node_by_path(name);
+}
+
 int of_probe(void)
 {
 	struct device_node *memory;
@@ -1901,9 +2055,16 @@ int of_probe(void)
 	if (memory)
 		of_add_memory(memory, false);
 
+	if (IS_ENABLED(CONFIG_OF_DEEP_PROBE) &&
+	    of_property_read_bool(of_chosen, "barebox,deep-probe"))
+		deep_probe_enable();
+
 	of_platform_populate(root_node, of_default_bus_match_table, NULL);
 	of_clk_init(root_node, NULL);
 
+	if (deep_probe_is_enabled())
+		of_device_ensure_probed(of_get_stdout_node());
+
 	return 0;
 }
 
@@ -1955,6 +2116,7 @@ void of_delete_node(struct device_node *node)
 {
 	struct device_node *n, *nt;
 	struct property *p, *pt;
+	struct alias_prop *ap, *apt;
 	struct device_d *dev;
 
 	if (!node)
@@ -1975,9 +2137,21 @@ void of_delete_node(struct device_node *node)
 	if (dev)
 		dev->device_node = NULL;
 
+	if (node == of_aliases)
+		of_aliases = NULL;
+
+	of_phandle_cache_remove(node);
+
+	list_for_each_entry_safe(ap, apt, &aliases_lookup, link) {
+		if (ap->np == node) {
+			list_del(&ap->link);
+			free(ap);
+		}
+	}
+
 	free(node->name);
 	free(node->full_name);
-	free(node);
+	mem_cache_free(&of_node_cache, node);
 
 	if (node == root_node)
 		of_set_root_node(NULL);
@@ -1986,16 +2160,8 @@ void of_delete_node(struct device_node *node)
 int of_device_is_stdout_path(struct device_d *dev)
 {
 	struct device_node *dn;
-	const char *name;
-
-	name = of_get_property(of_chosen, "stdout-path", NULL);
-	if (!name)
-		name = of_get_property(of_chosen, "linux,stdout-path", NULL);
-
-	if (!name)
-		return 0;
 
-	dn = of_find_node_by_path(name);
+	dn = of_get_stdout_node();
 	if (!dn)
 		return 0;
 
@@ -110,14 +110,7 @@ static int of_unflatten_reservemap(struct device_node *root,
 	return 0;
 }
 
-/**
- * of_unflatten_dtb - unflatten a dtb binary blob
- * @infdt - the fdt blob to unflatten
- *
- * Parse a flat device tree binary blob and return a pointer to the
- * unflattened tree.
- */
-struct device_node *of_unflatten_dtb(const void *infdt)
+static struct device_node *__of_unflatten_dtb(const void *infdt, bool constprops)
 {
 	const void *nodep;	/* property node pointer */
 	uint32_t tag;		/* tag */
@@ -221,9 +214,12 @@ struct device_node *of_unflatten_dtb(const void *infdt)
 				goto err;
 			}
 
-			p = of_new_property(node, name, nodep, len);
+			if (constprops)
+				p = of_new_property_const(node, name, nodep, len);
+			else
+				p = of_new_property(node, name, nodep, len);
 			if (!strcmp(name, "phandle") && len == 4)
-				node->phandle = be32_to_cpup(p->value);
+				node->phandle = be32_to_cpup(of_property_get_value(p));
 
 			dt_struct = dt_struct_advance(&f, dt_struct,
 					sizeof(struct fdt_property) + len);
@@ -255,6 +251,32 @@ err:
 	return ERR_PTR(ret);
 }
 
+/**
+ * of_unflatten_dtb - unflatten a dtb binary blob
+ * @infdt - the fdt blob to unflatten
+ *
+ * Parse a flat device tree binary blob and return a pointer to the
+ * unflattened tree.
+ */
+struct device_node *of_unflatten_dtb(const void *infdt)
+{
+	return __of_unflatten_dtb(infdt, false);
+}
+
+/**
+ * of_unflatten_dtb_const - unflatten a dtb binary blob without copying values
+ * @infdt - the fdt blob to unflatten
+ *
+ * Like of_unflatten_dtb(), but the property values of the resulting tree
+ * point into @infdt instead of being copied. This saves time and memory
+ * for big trees, but @infdt must not be freed or changed before the tree
+ * is deleted.
+ */
+struct device_node *of_unflatten_dtb_const(const void *infdt)
+{
+	return __of_unflatten_dtb(infdt, true);
+}
+
 struct fdt {
 	void *dt;
 	uint32_t dt_nextofs;
@@ -384,7 +406,7 @@ static int __of_flatten_dtb(struct fdt *fdt, struct device_node *node, int is_ro
 		fp->tag = cpu_to_fdt32(FDT_PROP);
 		fp->len = cpu_to_fdt32(p->length);
 		fp->nameoff = cpu_to_fdt32(dt_add_string(fdt, p->name));
-		memcpy(fp->data, p->value, p->length);
+		memcpy(fp->data, of_property_get_value(p), p->length);
 		fdt->dt_nextofs = dt_next_ofs(fdt->dt_nextofs,
 				sizeof(struct fdt_property) + p->length);
 	}
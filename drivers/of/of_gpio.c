@@ -3,6 +3,7 @@
 #include <of.h>
 #include <of_gpio.h>
 #include <gpio.h>
+#include <driver.h>
 
 /**
  * of_get_named_gpio_flags() - Get a GPIO number and flags to use with GPIO API
@@ -30,16 +31,18 @@ int of_get_named_gpio_flags(struct device_node *np, const char *propname,
 		return ret;
 	}
 
+	of_device_ensure_probed(out_args.np);
+
 	dev = of_find_device_by_node(out_args.np);
 	if (!dev) {
 		pr_debug("%s: unable to find device of node %s\n",
 			 __func__, out_args.np->full_name);
-		return -EPROBE_DEFER;
+		return device_defer_probe(out_args.np);
 	}
 
 	ret = gpio_get_num(dev, out_args.args[0]);
 	if (ret == -EPROBE_DEFER)
-		return ret;
+		return device_defer_probe(out_args.np);
 	if (ret < 0) {
 		pr_err("%s: unable to get gpio num of device %s: %d\n",
 			__func__, dev_name(dev), ret);
@@ -39,6 +39,68 @@ struct device_d *of_find_device_by_node(struct device_node *np)
 }
 EXPORT_SYMBOL(of_find_device_by_node);
 
+#ifdef CONFIG_OF_DEEP_PROBE
+/**
+ * of_device_ensure_probed - make sure the device of a node is probed
+ * @np: the device node
+ *
+ * With deep probe enabled devices from the devicetree are only probed when
+ * they are needed. This probes the device created for @np. If there is
+ * no device for @np yet, the devices of its parents are probed first as
+ * their drivers may create it. Subnodes of a device, like partitions or
+ * pin configurations, resolve to the device of their parent.
+ *
+ * Return: 0 if the device is probed, a negative error code otherwise
+ */
+int of_device_ensure_probed(struct device_node *np)
+{
+	struct device_d *dev;
+	int ret;
+
+	if (!deep_probe_is_enabled())
+		return -ENOSYS;
+
+	if (!np || !np->parent)
+		return -ENODEV;
+
+	dev = of_find_device_by_node(np);
+	if (dev)
+		return device_ensure_probed(dev);
+
+	ret = of_device_ensure_probed(np->parent);
+	if (ret)
+		return ret;
+
+	dev = of_find_device_by_node(np);
+	if (!dev)
+		return 0;
+
+	return device_ensure_probed(dev);
+}
+EXPORT_SYMBOL(of_device_ensure_probed);
+
+/**
+ * of_device_ensure_probed_by_alias - probe the device of an alias
+ * @alias: the alias, for example "mmc2"
+ *
+ * Return: 0 if the device is probed, a negative error code otherwise
+ */
+int of_device_ensure_probed_by_alias(const char *alias)
+{
+	struct device_node *np;
+
+	if (!deep_probe_is_enabled())
+		return -ENOSYS;
+
+	np = of_find_node_by_alias(NULL, alias);
+	if (!np)
+		return -ENODEV;
+
+	return of_device_ensure_probed(np);
+}
+EXPORT_SYMBOL(of_device_ensure_probed_by_alias);
+#endif
+
 /**
  * of_device_make_bus_id - Use the device node data to assign a unique name
  * @dev: pointer to device structure that is linked to a device tree node
@@ -84,6 +84,8 @@ static int pinctrl_config_one(struct device_node *np)
 	struct pinctrl_device *pdev;
 	struct device_node *pinctrl_node = np;
 
+	of_device_ensure_probed(np);
+
 	while (1) {
 		pinctrl_node = pinctrl_node->parent;
 		if (!pinctrl_node)
@@ -124,7 +126,7 @@ int of_pinctrl_select_state(struct device_node *np, const char *name)
 
 		size = prop->length;
 
-		list = prop->value;
+		list = of_property_get_value(prop);
 		size /= sizeof(*list);
 
 		/* Determine whether pinctrl-names property names the state */
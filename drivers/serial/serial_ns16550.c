@@ -258,6 +258,11 @@ static void ns16550_putc(struct console_device *cdev, char c)
 	ns16550_write(cdev, c, thr);
 }
 
+static int ns16550_tx_ready(struct console_device *cdev)
+{
+	return ns16550_read(cdev, lsr) & LSR_THRE;
+}
+
 /**
  * @brief Retrieve a character from serial port
  *
@@ -461,6 +466,7 @@ static int ns16550_probe(struct device_d *dev)
 	cdev->dev = dev;
 	cdev->tstc = ns16550_tstc;
 	cdev->putc = ns16550_putc;
+	cdev->tx_ready = ns16550_tx_ready;
 	cdev->getc = ns16550_getc;
 	cdev->setbrg = ns16550_setbaudrate;
 	cdev->linux_console_name = devtype->linux_console_name;
@@ -131,7 +131,7 @@ static void spi_of_register_slaves(struct spi_master *master)
 		reg = of_find_property(n, "reg", NULL);
 		if (!reg)
 			continue;
-		chip.chip_select = of_read_number(reg->value, 1);
+		chip.chip_select = of_read_number(of_property_get_value(reg), 1);
 		chip.device_node = n;
 		spi_register_board_info(&chip, 1);
 	}
@@ -32,6 +32,7 @@
 #include <ubiformat.h>
 #include <stdlib.h>
 #include <file-list.h>
+#include <image-sparse.h>
 #include <progress.h>
 #include <environment.h>
 #include <globalvar.h>
@@ -691,6 +692,20 @@ static void cb_flash(struct usb_ep *ep, struct usb_request *req, const char *cmd
 		return;
 	}
 
+	if (IS_ENABLED(CONFIG_IMAGE_SPARSE) &&
+	    filetype == filetype_android_sparse) {
+		fastboot_tx_print(f_fb, "INFOThis is a sparse image...");
+
+		ret = write_sparse_image(FASTBOOT_TMPFILE, filename,
+					 IMAGE_WRITE_ERASE | IMAGE_WRITE_VERBOSE);
+		if (ret) {
+			fastboot_tx_print(f_fb, "FAILwrite partition: %s", strerror(-ret));
+			return;
+		}
+
+		goto out;
+	}
+
 	if (filetype == filetype_ubi) {
 		int fd;
 		struct mtd_info_user meminfo;
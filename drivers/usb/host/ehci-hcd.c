@@ -66,7 +66,11 @@ struct int_queue {
 #define to_ehci(ptr) container_of(ptr, struct ehci_priv, host)
 
 #define NUM_QH	2
-#define NUM_TD	3
+/* SETUP, up to EHCI_DATA_TD DATA and STATUS */
+#define EHCI_DATA_TD	8
+#define NUM_TD	(EHCI_DATA_TD + 2)
+/* each DATA qTD transfers at least four pages */
+#define EHCI_MAX_XFER	(EHCI_DATA_TD * 4 * 4096)
 
 static struct descriptor {
 	struct usb_hub_descriptor hub;
@@ -213,6 +217,20 @@ static int ehci_td_buffer(struct qTD *td, void *buf, size_t sz)
 	return 0;
 }
 
+/*
+ * Number of bytes of buf a single qTD can transfer: five pages less the
+ * offset into the first one, in whole packets unless it's the rest.
+ */
+static int ehci_td_max_length(void *buf, int sz, int maxpacket)
+{
+	int max = 5 * 4096 - ((unsigned long)buf & 4095);
+
+	if (sz <= max)
+		return sz;
+
+	return max - max % maxpacket;
+}
+
 static int
 ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 		   int length, struct devrequest *req, int timeout_ms)
@@ -226,7 +244,7 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	uint32_t endpt, token, usbsts;
 	uint32_t c, toggle;
 	uint32_t cmd;
-	int ret = 0, i;
+	int ret = 0, i, data_td = 0, maxpacket = usb_maxpacket(dev, pipe);
 	uint64_t start, timeout_val;
 
 	dev_dbg(ehci->dev, "pipe=%lx, buffer=%p, length=%d, req=%p\n", pipe,
@@ -300,27 +318,61 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	}
 
 	if (length > 0 || req == NULL) {
-		td = &ehci->td[1];
+		void *buf = buffer;
+		int left = length;
+		uint32_t altnext;
 
-		td->qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
-		td->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
-		token = (toggle << 31) |
-		    (length << 16) |
-		    ((req == NULL ? 1 : 0) << 15) |
-		    (0 << 12) |
-		    (3 << 10) |
-		    ((usb_pipein(pipe) ? 1 : 0) << 8) | (0x80 << 0);
-		td->qt_token = cpu_to_hc32(token);
-		if (ehci_td_buffer(td, buffer, length) != 0) {
-			dev_err(ehci->dev, "unable construct DATA td\n");
-			goto fail;
+		/*
+		 * A short packet skips the remaining DATA qTDs: control
+		 * transfers continue with the STATUS stage, bulk transfers
+		 * stop at an inactive qTD.
+		 */
+		td = &ehci->td[NUM_TD - 1];
+		if (!req) {
+			td->qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+			td->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
 		}
-		*tdp = cpu_to_hc32((uint32_t) td);
-		tdp = &td->qt_next;
+		altnext = cpu_to_hc32((uint32_t)td);
+
+		/* chain as many DATA qTDs as the buffer needs */
+		do {
+			int now = ehci_td_max_length(buf, left, maxpacket);
+
+			if (data_td == EHCI_DATA_TD) {
+				dev_err(ehci->dev, "transfer of %d bytes too large\n",
+					length);
+				goto fail;
+			}
+
+			td = &ehci->td[1 + data_td++];
+
+			td->qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
+			td->qt_altnext = altnext;
+			token = (toggle << 31) |
+			    (now << 16) |
+			    ((req == NULL ? 1 : 0) << 15) |
+			    (0 << 12) |
+			    (3 << 10) |
+			    ((usb_pipein(pipe) ? 1 : 0) << 8) | (0x80 << 0);
+			td->qt_token = cpu_to_hc32(token);
+			if (ehci_td_buffer(td, buf, now) != 0) {
+				dev_err(ehci->dev, "unable construct DATA td\n");
+				goto fail;
+			}
+			*tdp = cpu_to_hc32((uint32_t) td);
+			tdp = &td->qt_next;
+
+			/* the toggle of the next qTD follows the packet count */
+			if ((now / maxpacket) & 1)
+				toggle ^= 1;
+
+			buf += now;
+			left -= now;
+		} while (left > 0);
 	}
 
 	if (req) {
-		td = &ehci->td[2];
+		td = &ehci->td[NUM_TD - 1];
 
 		td->qt_next = cpu_to_hc32(QT_NEXT_TERMINATE);
 		td->qt_altnext = cpu_to_hc32(QT_NEXT_TERMINATE);
@@ -369,6 +421,15 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 	vtd = td;
 	do {
 		token = hc32_to_cpu(vtd->qt_token);
+		/*
+		 * An error ends the transfer before the last qTD is done, so
+		 * does a short packet on a bulk transfer. Control transfers
+		 * continue with the STATUS qTD after one, wait for it.
+		 */
+		c = hc32_to_cpu(qh->qt_token);
+		if (!(c & 0x80) &&
+		    ((c & 0x40) || (!req && (c >> 16) & 0x7fff)))
+			break;
 		if (is_timeout_non_interruptible(start, timeout_val)) {
 			/* Disable async schedule. */
 			cmd = ehci_readl(&ehci->hcor->or_usbcmd);
@@ -432,7 +493,10 @@ ehci_submit_async(struct usb_device *dev, unsigned long pipe, void *buffer,
 				dev->status |= USB_ST_STALLED;
 			break;
 		}
-		dev->act_len = length - ((token >> 16) & 0x7fff);
+		dev->act_len = length;
+		for (i = 1; i <= data_td; i++)
+			dev->act_len -= (hc32_to_cpu(ehci->td[i].qt_token) >> 16) &
+					0x7fff;
 	} else {
 		dev->act_len = 0;
 		dev_dbg(ehci->dev, "dev=%u, usbsts=%#x, p[1]=%#x, p[2]=%#x\n",
@@ -811,7 +875,7 @@ static int ehci_init(struct usb_host *host)
 			return ret;
 	}
 
-	memset(ehci->qh_list, 0, sizeof(struct QH) * NUM_TD);
+	memset(ehci->qh_list, 0, sizeof(struct QH) * NUM_QH);
 
 	ehci->qh_list->qh_link = cpu_to_hc32((uint32_t)ehci->qh_list | QH_LINK_TYPE_QH);
 	ehci->qh_list->qh_endpt1 = cpu_to_hc32((1 << 15) | (USB_SPEED_HIGH << 12));
@@ -1303,7 +1367,7 @@ int ehci_register(struct device_d *dev, struct ehci_data *data)
 	ehci->init = data->init;
 	ehci->post_init = data->post_init;
 
-	ehci->qh_list = dma_alloc_coherent(sizeof(struct QH) * NUM_TD,
+	ehci->qh_list = dma_alloc_coherent(sizeof(struct QH) * NUM_QH,
 					   DMA_ADDRESS_BROKEN);
 	ehci->periodic_queue = dma_alloc_coherent(sizeof(struct QH),
 						  DMA_ADDRESS_BROKEN);
@@ -1316,6 +1380,7 @@ int ehci_register(struct device_d *dev, struct ehci_data *data)
 	host->submit_int_msg = submit_int_msg;
 	host->submit_control_msg = submit_control_msg;
 	host->submit_bulk_msg = submit_bulk_msg;
+	host->max_xfer_size = EHCI_MAX_XFER;
 
 	if (ehci->flags & EHCI_HAS_TT) {
 		ehci_reset(ehci);
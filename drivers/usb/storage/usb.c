@@ -189,10 +189,22 @@ static int usb_stor_write_10(ccb *srb, struct us_data *us,
  * Disk driver interface
  ***********************************************************************/
 
+/* used when the host controller doesn't tell its transfer limit */
 #define US_MAX_IO_BLK 32
 
 #define to_usb_mass_storage(x) container_of((x), struct us_blk_dev, blk)
 
+/* Number of sectors a single READ(10) / WRITE(10) may transfer */
+static unsigned usb_stor_max_io_blk(struct us_data *us)
+{
+	size_t max = us->pusb_dev->host->max_xfer_size;
+
+	if (!max)
+		return US_MAX_IO_BLK;
+
+	return min_t(size_t, max / SECTOR_SIZE, 0xffff);
+}
+
 enum { io_rd, io_wr };
 
 /* Read / write a chunk of sectors on media */
@@ -202,7 +214,7 @@ static int usb_stor_blk_io(int io_op, struct block_device *disk_dev,
 	struct us_blk_dev *pblk_dev = to_usb_mass_storage(disk_dev);
 	struct us_data *us = pblk_dev->us;
 	ccb us_ccb;
-	unsigned sectors_done;
+	unsigned sectors_done, max_io_blk;
 
 	if (sector_count == 0)
 		return 0;
@@ -224,12 +236,17 @@ static int usb_stor_blk_io(int io_op, struct block_device *disk_dev,
 	us_ccb.lun = pblk_dev->lun;
 	usb_disable_asynch(1);
 
-	/* ensure unit ready */
-	US_DEBUGP("Testing for unit ready\n");
-	if (usb_stor_test_unit_ready(&us_ccb, us)) {
-		US_DEBUGP("Device NOT ready\n");
-		usb_disable_asynch(0);
-		return -EIO;
+	/*
+	 * ensure unit ready, unless the last I/O succeeded: then it still
+	 * is and the extra round trip would only slow down the transfer
+	 */
+	if (!pblk_dev->ready) {
+		US_DEBUGP("Testing for unit ready\n");
+		if (usb_stor_test_unit_ready(&us_ccb, us)) {
+			US_DEBUGP("Device NOT ready\n");
+			usb_disable_asynch(0);
+			return -EIO;
+		}
 	}
 
 	/* possibly limit the amount of I/O data */
@@ -247,9 +264,10 @@ static int usb_stor_blk_io(int io_op, struct block_device *disk_dev,
 	          ((io_op == io_rd) ? "Read" : "Write"),
 	          sector_count, sector_start);
 	sectors_done = 0;
+	max_io_blk = usb_stor_max_io_blk(us);
 	while (sector_count > 0) {
 		int result;
-		unsigned n = min(sector_count, US_MAX_IO_BLK);
+		unsigned n = min_t(unsigned, sector_count, max_io_blk);
 		us_ccb.pdata = buffer + (sectors_done * SECTOR_SIZE);
 		us_ccb.datalen = n * SECTOR_SIZE;
 		if (io_op == io_rd)
@@ -269,6 +287,8 @@ static int usb_stor_blk_io(int io_op, struct block_device *disk_dev,
 
 	usb_disable_asynch(0);
 
+	pblk_dev->ready = sector_count == 0;
+
 	US_DEBUGP("Successful I/O of %d blocks\n", sectors_done);
 
 	return (sector_count != 0) ? -EIO : 0;
@@ -359,10 +379,14 @@ static int usb_stor_init_blkdev(struct us_blk_dev *pblk_dev)
 	}
 	pcap = (unsigned long *)us_ccb.pdata;
 	US_DEBUGP("Read Capacity returns: 0x%lx, 0x%lx\n", pcap[0], pcap[1]);
-	pblk_dev->blk.num_blocks = usb_limit_blk_cnt(be32_to_cpu(pcap[0]) + 1);
+	/* the last LBA, 0xffffffff means the device needs READ CAPACITY(16) */
+	pblk_dev->blk.num_blocks = be32_to_cpu(pcap[0]) == 0xffffffff ?
+		usb_limit_blk_cnt(0xffffffff) :
+		usb_limit_blk_cnt(be32_to_cpu(pcap[0]) + 1);
 	if (be32_to_cpu(pcap[1]) != SECTOR_SIZE)
 		pr_warn("Support only %d bytes sectors\n", SECTOR_SIZE);
 	pblk_dev->blk.blockbits = SECTOR_SHIFT;
+	pblk_dev->ready = 1;
 	US_DEBUGP("Capacity = 0x%x, blockshift = 0x%x\n",
 	          pblk_dev->blk.num_blocks, pblk_dev->blk.blockbits);
 
@@ -23,6 +23,8 @@
 #include <malloc.h>
 #include <ioctl.h>
 #include <nand.h>
+#include <of.h>
+#include <poller.h>
 #include <linux/err.h>
 #include <linux/mtd/mtd.h>
 
@@ -68,6 +70,42 @@ struct cdev *lcdev_by_name(const char *filename)
 	return NULL;
 }
 
+/**
+ * lcdev_by_name_ensure_probed - lcdev_by_name() with probing on demand
+ * @filename: the cdev name
+ *
+ * With deep probe the device providing a cdev may not have been probed
+ * yet, and with background work pending it may still be initializing.
+ * If the cdev does not exist, probe and detect the device with the
+ * alias matching the cdev name without partition suffix, like mmc2 for
+ * mmc2.0, and look again.
+ */
+struct cdev *lcdev_by_name_ensure_probed(const char *filename)
+{
+	struct cdev *cdev;
+	char *alias, *dot;
+	int ret;
+
+	cdev = lcdev_by_name(filename);
+	if (cdev || !(deep_probe_is_enabled() || poller_work_busy()))
+		return cdev;
+
+	alias = xstrdup(filename);
+	dot = strchr(alias, '.');
+	if (dot)
+		*dot = 0;
+
+	ret = 0;
+	if (deep_probe_is_enabled())
+		ret = of_device_ensure_probed_by_alias(alias);
+	if (!ret)
+		device_detect_by_name(alias);
+
+	free(alias);
+
+	return ret ? NULL : lcdev_by_name(filename);
+}
+
 struct cdev *cdev_by_name(const char *filename)
 {
 	struct cdev *cdev;
@@ -141,10 +179,12 @@ struct cdev *cdev_open(const char *name, unsigned long flags)
 	if (!strncmp(name, "/dev/", 5))
 		name += 5;
 
-	cdev = cdev_by_name(name);
+	cdev = lcdev_by_name_ensure_probed(name);
 	if (!cdev)
 		return NULL;
 
+	cdev = cdev_readlink(cdev);
+
 	if (cdev->ops->open) {
 		ret = cdev->ops->open(cdev, flags);
 		if (ret)
@@ -217,7 +217,7 @@ static int devfs_stat(struct device_d *_dev, const char *filename, struct stat *
 {
 	struct cdev *cdev;
 
-	cdev = lcdev_by_name(filename + 1);
+	cdev = lcdev_by_name_ensure_probed(filename + 1);
 	if (!cdev)
 		return -ENOENT;
 
@@ -22,6 +22,7 @@ struct block_device {
 	int num_blocks;
 	int rdbufsize;
 	int blkmask;
+	int max_blocks;		/* largest request ops handle, 0 for default */
 
 	struct list_head buffered_blocks;
 	struct list_head idle_blocks;
@@ -0,0 +1,44 @@
+#ifndef __BOOTCHART_H
+#define __BOOTCHART_H
+
+#include <linux/types.h>
+#include <clock.h>
+
+enum bootchart_type {
+	BOOTCHART_PHASE,
+	BOOTCHART_INITCALL,
+	BOOTCHART_PROBE,
+	BOOTCHART_SCRIPT,
+};
+
+#ifdef CONFIG_BOOTCHART
+static inline uint64_t bootchart_start(void)
+{
+	return get_time_ns();
+}
+
+void bootchart_record(enum bootchart_type type, const char *name,
+		      const void *fn, int result, uint64_t start);
+void bootchart_stop(void);
+void bootchart_print(unsigned int threshold_us, bool sort);
+#else
+static inline uint64_t bootchart_start(void)
+{
+	return 0;
+}
+
+static inline void bootchart_record(enum bootchart_type type,
+		const char *name, const void *fn, int result, uint64_t start)
+{
+}
+
+static inline void bootchart_stop(void)
+{
+}
+
+static inline void bootchart_print(unsigned int threshold_us, bool sort)
+{
+}
+#endif
+
+#endif /* __BOOTCHART_H */
@@ -48,6 +48,7 @@ struct command {
 	const char	*opts;		/* command options */
 
 	struct list_head list;		/* List of commands		*/
+	struct hlist_node hash;		/* Entry in the name hash	*/
 	uint32_t	group;
 #ifdef	CONFIG_LONGHELP
 	const char	*help;		/* Help  message	(long)	*/
@@ -66,6 +67,7 @@ extern struct command __barebox_cmd_end;
 
 /* common/command.c */
 struct command *find_cmd(const char *cmd);
+void command_print_lookup_stats(void);
 int execute_command(int argc, char **argv);
 void barebox_cmd_usage(struct command *cmdtp);
 int run_command(const char *cmd);
@@ -46,6 +46,8 @@ struct console_device {
 	int (*set_mode)(struct console_device *cdev, enum console_mode mode);
 	int (*open)(struct console_device *cdev);
 	int (*close)(struct console_device *cdev);
+	/* optional: true if putc would not have to wait for the hardware */
+	int (*tx_ready)(struct console_device *cdev);
 
 	char *devname;
 	int devid;
@@ -64,6 +66,9 @@ struct console_device {
 
 	struct cdev devfs;
 	struct file_operations fops;
+
+	struct kfifo *tx_fifo;
+	void (*tx_putc)(struct console_device *cdev, char c);
 };
 
 int console_register(struct console_device *cdev);
@@ -16,6 +16,11 @@
 
 #define DMA_ADDRESS_BROKEN	NULL
 
+/* buffers passed to DMA capable drivers must be aligned to this */
+#ifndef DMA_ALIGNMENT
+#define DMA_ALIGNMENT	1
+#endif
+
 #ifndef dma_alloc
 static inline void *dma_alloc(size_t size)
 {
@@ -74,11 +74,21 @@ struct device_d {
 	/*! The parameters for this device. This is used to carry information
 	 * of board specific data from the board code to the device driver. */
 	struct list_head parameters;
+	/*! Incremented whenever a parameter is set, added or removed, so that
+	 * users can cache values derived from the parameters. */
+	unsigned int param_generation;
 
 	struct list_head cdevs;
 
 	const struct platform_device_id *id_entry;
 	struct device_node *device_node;
+	/* provider this device waits for when its probe was deferred */
+	struct device_node *deferred_on;
+	/* with deep probe only requested devices are probed */
+	bool probe_requested;
+	/* node under which this device is in the driver match index */
+	struct device_node *match_index_node;
+	unsigned int match_gen;
 
 	const struct of_device_id *of_id_entry;
 
@@ -109,6 +119,8 @@ struct driver_d {
 
 	const struct platform_device_id *id_table;
 	const struct of_device_id *of_compatible;
+
+	unsigned int match_gen;
 };
 
 /*@}*/	/* do not delete, doxygen relevant */
@@ -131,6 +143,20 @@ int register_device(struct device_d *);
  */
 int device_probe(struct device_d *dev);
 
+/*
+ * Defer the probe of the device currently being probed until the device
+ * providing @provider is probed. Returns -EPROBE_DEFER.
+ */
+int device_defer_probe(struct device_node *provider);
+
+/*
+ * With deep probe enabled devices from the devicetree are only probed once
+ * they are requested with device_ensure_probed().
+ */
+void deep_probe_enable(void);
+bool deep_probe_is_enabled(void);
+int device_ensure_probed(struct device_d *dev);
+
 /* detect devices attached to this device (cards, disks,...) */
 int device_detect(struct device_d *dev);
 int device_detect_by_name(const char *devname);
@@ -468,6 +494,7 @@ int cdev_find_free_index(const char *);
 struct cdev *device_find_partition(struct device_d *dev, const char *name);
 struct cdev *cdev_by_name(const char *filename);
 struct cdev *lcdev_by_name(const char *filename);
+struct cdev *lcdev_by_name_ensure_probed(const char *filename);
 struct cdev *cdev_readlink(struct cdev *cdev);
 struct cdev *cdev_by_device_node(struct device_node *node);
 struct cdev *cdev_open(const char *name, unsigned long flags);
@@ -7,6 +7,7 @@
 #include <stringlist.h>
 
 extern struct device_d global_device;
+extern struct device_d nv_device;
 
 #ifdef CONFIG_GLOBALVAR
 int globalvar_add_simple(const char *name, const char *value);
@@ -131,4 +132,31 @@ void nv_var_set_clean(void);
 int nvvar_save(void);
 int nv_global_complete(struct string_list *sl, char *instr);
 
+#ifdef CONFIG_NVVAR_JOURNAL
+void nv_journal_set_path(const char *path);
+int nv_journal_enabled(void);
+int nv_journal_load(void (*apply)(const char *name, const char *value));
+int nv_journal_save(void);
+#else
+static inline void nv_journal_set_path(const char *path)
+{
+}
+
+static inline int nv_journal_enabled(void)
+{
+	return 0;
+}
+
+static inline int nv_journal_load(void (*apply)(const char *name,
+						const char *value))
+{
+	return -ENOSYS;
+}
+
+static inline int nv_journal_save(void)
+{
+	return -ENOSYS;
+}
+#endif
+
 #endif /* __GLOBALVAR_H */
@@ -19,11 +19,15 @@
 #define __IMAGE_FIT_H__
 
 #include <linux/types.h>
+#include <linux/list.h>
 #include <bootm.h>
 
 struct fit_handle {
 	void *fit;
 	size_t size;
+	int fd;
+	bool mapped;
+	struct list_head ext_data;
 
 	bool verbose;
 	enum bootm_verify verify;
@@ -0,0 +1,106 @@
+#ifndef __IMAGE_SPARSE_H
+#define __IMAGE_SPARSE_H
+
+#include <linux/types.h>
+#include <errno.h>
+
+/*
+ * Android sparse image format, see system/core/libsparse/sparse_format.h
+ * in the Android sources.
+ */
+#define SPARSE_HEADER_MAGIC	0xed26ff3a
+
+#define CHUNK_TYPE_RAW		0xcac1
+#define CHUNK_TYPE_FILL		0xcac2
+#define CHUNK_TYPE_DONT_CARE	0xcac3
+#define CHUNK_TYPE_CRC32	0xcac4
+
+struct sparse_header {
+	__le32 magic;
+	__le16 major_version;
+	__le16 minor_version;
+	__le16 file_hdr_sz;	/* 28 bytes for first revision */
+	__le16 chunk_hdr_sz;	/* 12 bytes for first revision */
+	__le32 blk_sz;		/* block size in bytes, multiple of 4 */
+	__le32 total_blks;	/* total blocks in the non-sparse image */
+	__le32 total_chunks;
+	__le32 image_checksum;
+};
+
+struct chunk_header {
+	__le16 chunk_type;
+	__le16 reserved1;
+	__le32 chunk_sz;	/* in blocks of the output image */
+	__le32 total_sz;	/* in bytes, including this header */
+};
+
+/*
+ * barebox delta image: the blocks in which a new image differs from the
+ * image installed on the device (the base). It consists of a struct
+ * delta_header followed by total_chunks chunks, each a struct delta_chunk
+ * followed by its data. The chunks are sorted by block and don't overlap.
+ * Raw chunks carry the data of their blocks, fill chunks a 32bit value
+ * their blocks are filled with. Data beyond image_size is not stored.
+ */
+#define DELTA_HEADER_MAGIC	0x746c6462	/* "bdlt" */
+#define DELTA_HASH_SZ		32		/* sha256 */
+
+struct delta_header {
+	__le32 magic;
+	__le16 major_version;	/* 1 */
+	__le16 hdr_sz;		/* 96 bytes for the first revision */
+	__le32 blk_sz;		/* in bytes, multiple of 4 */
+	__le32 total_chunks;
+	__le64 base_size;	/* size of the base image in bytes */
+	__le64 image_size;	/* size of the new image in bytes */
+	u8 base_hash[DELTA_HASH_SZ];
+	u8 image_hash[DELTA_HASH_SZ];
+};
+
+struct delta_chunk {
+	__le16 chunk_type;	/* CHUNK_TYPE_RAW or CHUNK_TYPE_FILL */
+	__le16 reserved;
+	__le32 nr_blks;
+	__le64 blk;		/* first block of the chunk */
+};
+
+/* unprotect and erase the destination before writing the mapped ranges */
+#define IMAGE_WRITE_ERASE	(1 << 0)
+/* show a progression bar */
+#define IMAGE_WRITE_VERBOSE	(1 << 1)
+
+#ifdef CONFIG_IMAGE_SPARSE
+int write_sparse_image(const char *image, const char *dst, unsigned flags);
+int write_bmap_image(const char *image, const char *bmap, const char *dst,
+		     unsigned flags);
+char *image_find_bmap(const char *image);
+#else
+static inline int write_sparse_image(const char *image, const char *dst,
+				     unsigned flags)
+{
+	return -ENOSYS;
+}
+
+static inline int write_bmap_image(const char *image, const char *bmap,
+				   const char *dst, unsigned flags)
+{
+	return -ENOSYS;
+}
+
+static inline char *image_find_bmap(const char *image)
+{
+	return NULL;
+}
+#endif
+
+#ifdef CONFIG_IMAGE_DELTA
+int write_delta_image(const char *image, const char *dst, unsigned flags);
+#else
+static inline int write_delta_image(const char *image, const char *dst,
+				    unsigned flags)
+{
+	return -ENOSYS;
+}
+#endif
+
+#endif /* __IMAGE_SPARSE_H */
@@ -13,6 +13,8 @@ int read_file_2(const char *filename, size_t *size, void **outbuf,
 
 int write_file(const char *filename, void *buf, size_t size);
 
+void *alloc_file_buf(size_t maxsize, size_t *size);
+
 int copy_file(const char *src, const char *dst, int verbose);
 
 int copy_recursive(const char *src, const char *dst);
@@ -46,6 +46,12 @@
  *                          parsed from the stream headers. If the
  *                          allocation fails, xz_dec_run() will return
  *                          XZ_MEM_ERROR.
+ * @XZ_OUTDICT:             Multi-call input, but the output buffer is
+ *                          used as the LZMA2 dictionary like in
+ *                          XZ_SINGLE. The whole uncompressed data must
+ *                          fit into b->out and b->out must not change
+ *                          between calls to xz_dec_run(). Requires
+ *                          single-call support (XZ_DEC_SINGLE).
  *
  * It is possible to enable support only for a subset of the above
  * modes at compile time by defining XZ_DEC_SINGLE, XZ_DEC_PREALLOC,
@@ -56,7 +62,8 @@
 enum xz_mode {
 	XZ_SINGLE,
 	XZ_PREALLOC,
-	XZ_DYNALLOC
+	XZ_DYNALLOC,
+	XZ_OUTDICT
 };
 
 /**
@@ -64,7 +71,7 @@ enum xz_mode {
  * @XZ_OK:                  Everything is OK so far. More input or more
  *                          output space is required to continue. This
  *                          return code is possible only in multi-call mode
- *                          (XZ_PREALLOC or XZ_DYNALLOC).
+ *                          (XZ_PREALLOC, XZ_DYNALLOC or XZ_OUTDICT).
  * @XZ_STREAM_END:          Operation finished successfully.
  * @XZ_UNSUPPORTED_CHECK:   Integrity check type is not supported. Decoding
  *                          is still possible in multi-call mode by simply
@@ -184,6 +191,13 @@ struct xz_dec;
  * XZ_MEMLIMIT_ERROR. Thus, it is important to know what kind of data will be
  * decoded to avoid allocating excessive amount of memory for the dictionary.
  *
+ * Multi-call mode with output buffer as dictionary (XZ_OUTDICT): input may
+ * be passed in chunks like in the other multi-call modes, while the output
+ * is decoded straight into its final location without a separate
+ * dictionary allocation and copy. This is meant for decompressing images
+ * into their load address while reading them from a file. dict_max is
+ * ignored.
+ *
  * Multi-call mode with dynamically allocated dictionary (XZ_DYNALLOC):
  * dict_max specifies the maximum allowed dictionary size that xz_dec_run()
  * may allocate once it has parsed the dictionary size from the stream
@@ -29,6 +29,7 @@
 #include <linux/list.h>
 #include <block.h>
 #include <regulator.h>
+#include <poller.h>
 
 /* These codes should be sorted numerically in order of newness.  If the last
  * nybble is a zero, it will not be printed.  So 0x120 -> "1.2" and 0x123 ->
@@ -476,6 +477,11 @@ struct mci {
 	u8 ext_csd_part_config;
 
 	struct list_head list;     /* The list of all mci devices */
+
+	struct poller_work probe_work;	/**< card probe in the background */
+	int probe_stage;
+	int probe_timeout;
+	struct mci_cmd probe_cmd;
 };
 
 int mci_register(struct mci_host*);
@@ -0,0 +1,48 @@
+#ifndef __MEM_CACHE_H
+#define __MEM_CACHE_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+
+/**
+ * struct mem_cache - pool of equally sized objects
+ * @name:	name shown in the statistics
+ * @size:	size of a single object
+ *
+ * Objects are carved from slabs allocated with malloc(), so allocating
+ * and freeing an object is a freelist operation and the heap sees one
+ * allocation per slab instead of one per object. Freed objects go back
+ * to the freelist of the cache. The slabs are returned to the heap once
+ * all objects of the cache are freed.
+ *
+ * Caches are defined statically with DEFINE_MEM_CACHE() and need no
+ * further initialization.
+ */
+struct mem_cache {
+	const char *name;
+	size_t size;
+
+	/* private */
+	void *freelist;
+	struct list_head slabs;
+	struct list_head list;
+	unsigned int objs_per_slab;
+	unsigned int nr_slabs;
+	unsigned int in_use;
+	unsigned int max_in_use;
+	unsigned long allocs;
+};
+
+#define DEFINE_MEM_CACHE(_var, _name, _size)				\
+	struct mem_cache _var = {					\
+		.name = _name,						\
+		.size = _size,						\
+		.slabs = LIST_HEAD_INIT(_var.slabs),			\
+		.list = LIST_HEAD_INIT(_var.list),			\
+	}
+
+void *mem_cache_alloc(struct mem_cache *cache);
+void mem_cache_free(struct mem_cache *cache, void *obj);
+void mem_cache_print_stats(void);
+
+#endif /* __MEM_CACHE_H */
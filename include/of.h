@@ -20,6 +20,7 @@ struct property {
 	char *name;
 	int length;
 	void *value;
+	const void *value_const;
 	struct list_head list;
 };
 
@@ -93,13 +94,24 @@ static inline void of_write_number(void *__cell, u64 val, int size)
 	}
 }
 
+/*
+ * Properties created by of_unflatten_dtb_const() point into the flat tree
+ * (value_const) instead of owning a copy of their value (value).
+ */
+static inline const void *of_property_get_value(const struct property *pp)
+{
+	return pp->value ? pp->value : pp->value_const;
+}
+
 void of_print_property(const void *data, int len);
 void of_print_cmdline(struct device_node *root);
 
 void of_print_nodes(struct device_node *node, int indent);
+void of_print_lookup_stats(void);
 int of_probe(void);
 int of_parse_dtb(struct fdt_header *fdt);
 struct device_node *of_unflatten_dtb(const void *fdt);
+struct device_node *of_unflatten_dtb_const(const void *fdt);
 
 struct cdev;
 
@@ -117,6 +129,8 @@ extern int of_set_property(struct device_node *node, const char *p,
 			const void *val, int len, int create);
 extern struct property *of_new_property(struct device_node *node,
 				const char *name, const void *data, int len);
+extern struct property *of_new_property_const(struct device_node *node,
+				const char *name, const void *data, int len);
 extern void of_delete_property(struct property *pp);
 
 extern struct device_node *of_find_node_by_name(struct device_node *from,
@@ -366,6 +380,12 @@ static inline struct property *of_new_property(struct device_node *node,
 	return NULL;
 }
 
+static inline struct property *of_new_property_const(struct device_node *node,
+				const char *name, const void *data, int len)
+{
+	return NULL;
+}
+
 static inline void of_delete_property(struct property *pp)
 {
 }
@@ -793,6 +813,21 @@ int of_device_enable_path(const char *path);
 int of_device_disable(struct device_node *node);
 int of_device_disable_path(const char *path);
 
+#ifdef CONFIG_OF_DEEP_PROBE
+int of_device_ensure_probed(struct device_node *np);
+int of_device_ensure_probed_by_alias(const char *alias);
+#else
+static inline int of_device_ensure_probed(struct device_node *np)
+{
+	return -ENOSYS;
+}
+
+static inline int of_device_ensure_probed_by_alias(const char *alias)
+{
+	return -ENOSYS;
+}
+#endif
+
 phandle of_get_tree_max_phandle(struct device_node *root);
 phandle of_node_create_phandle(struct device_node *node);
 int of_set_property_to_child_phandle(struct device_node *node, char *prop_name);
@@ -9,6 +9,7 @@
 #define PARAM_GLOBALVAR_UNQUALIFIED	(1 << 1)
 
 struct device_d;
+struct mem_cache;
 typedef uint32_t          IPaddr_t;
 
 struct param_d {
@@ -21,12 +22,15 @@ struct param_d {
 	struct device_d *dev;
 	void *driver_priv;
 	struct list_head list;
+	struct hlist_node hash;
+	struct mem_cache *cache;
 };
 
 #ifdef CONFIG_PARAMETER
 const char *dev_get_param(struct device_d *dev, const char *name);
 int dev_set_param(struct device_d *dev, const char *name, const char *val);
 struct param_d *get_param_by_name(struct device_d *dev, const char *name);
+void param_print_lookup_stats(void);
 
 struct param_d *dev_add_param(struct device_d *dev, const char *name,
 		int (*set)(struct device_d *dev, struct param_d *p, const char *val),
@@ -99,6 +103,10 @@ static inline struct param_d *get_param_by_name(struct device_d *dev,
 	return NULL;
 }
 
+static inline void param_print_lookup_stats(void)
+{
+}
+
 static inline struct param_d *dev_add_param(struct device_d *dev, char *name,
 		int (*set)(struct device_d *dev, struct param_d *p, const char *val),
 		const char *(*get)(struct device_d *, struct param_d *p),
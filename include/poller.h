@@ -9,6 +9,7 @@
 #define POLLER_H
 
 #include <linux/list.h>
+#include <errno.h>
 
 struct poller_struct {
 	void (*func)(struct poller_struct *poller);
@@ -36,12 +37,69 @@ int poller_call_async(struct poller_async *pa, uint64_t delay_ns,
 		void (*fn)(void *), void *ctx);
 int poller_async_cancel(struct poller_async *pa);
 
+/*
+ * Staged background work
+ *
+ * A poller_work is split into short stages. The stage function returns
+ * a positive value when there is more to do, 0 when the work is
+ * finished and a negative error code when it failed. A stage may ask
+ * to be called again not before a given delay has passed using
+ * poller_work_delay(). Stages are run from the idle points of barebox
+ * (the autoboot countdown, the shell prompt and between commands), one
+ * stage at a time, so a single stage should not take longer than a few
+ * milliseconds.
+ */
+struct poller_work {
+	struct list_head list;
+	const char *name;
+	int (*fn)(struct poller_work *work);
+	uint64_t resume;
+	int result;
+	int pending;
+};
+
 #ifdef CONFIG_POLLER
 void poller_call(void);
+
+int poller_work_start(struct poller_work *work, const char *name,
+		int (*fn)(struct poller_work *work));
+void poller_work_delay(struct poller_work *work, uint64_t delay_ns);
+int poller_work_wait(struct poller_work *work);
+void poller_work_run(void);
+int poller_work_busy(void);
 #else
 static inline void poller_call(void)
 {
 }
+
+static inline int poller_work_start(struct poller_work *work, const char *name,
+		int (*fn)(struct poller_work *work))
+{
+	return -ENOSYS;
+}
+
+static inline void poller_work_delay(struct poller_work *work, uint64_t delay_ns)
+{
+}
+
+static inline int poller_work_wait(struct poller_work *work)
+{
+	return work->result;
+}
+
+static inline void poller_work_run(void)
+{
+}
+
+static inline int poller_work_busy(void)
+{
+	return 0;
+}
 #endif	/* CONFIG_POLLER */
 
+static inline int poller_work_pending(struct poller_work *work)
+{
+	return work->pending;
+}
+
 #endif	/* !POLLER_H */
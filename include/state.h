@@ -17,9 +17,11 @@ void state_release(struct state *state);
 struct state *state_by_name(const char *name);
 struct state *state_by_node(const struct device_node *node);
 int state_get_name(const struct state *state, char const **name);
+unsigned int state_get_generation(const struct state *state);
 
 int state_load(struct state *state);
 int state_save(struct state *state);
+int state_save_deferred(struct state *state);
 void state_info(void);
 
 #endif /* __STATE_H */
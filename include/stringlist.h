@@ -19,15 +19,7 @@ static inline void string_list_init(struct string_list *sl)
 	INIT_LIST_HEAD(&sl->list);
 }
 
-static inline void string_list_free(struct string_list *sl)
-{
-	struct string_list *entry, *safe;
-
-	list_for_each_entry_safe(entry, safe, &sl->list, list) {
-		free(entry->str);
-		free(entry);
-	}
-}
+void string_list_free(struct string_list *sl);
 
 #define string_list_for_each_entry(entry, sl) \
 	list_for_each_entry(entry, &(sl)->list, list)
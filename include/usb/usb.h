@@ -147,6 +147,9 @@ struct usb_host {
 			int transfer_len, int interval);
 	void (*usb_event_poll)(void);
 
+	/* largest transfer a single submit can handle, 0 if unknown */
+	size_t max_xfer_size;
+
 	struct list_head list;
 
 	struct device_d *hw_dev;
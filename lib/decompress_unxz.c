@@ -227,7 +227,9 @@ static void memzero(void *buf, size_t size)
  * This wrapper will automatically choose single-call or multi-call mode
  * of the native XZ decoder API. The single-call mode can be used only when
  * both input and output buffers are available as a single chunk, i.e. when
- * fill() and flush() won't be used.
+ * fill() and flush() won't be used. When only fill() is used, the output
+ * buffer still is a single chunk and doubles as the dictionary
+ * (XZ_OUTDICT), so no dictionary has to be allocated and copied out.
  */
 STATIC int decompress_unxz(unsigned char *in, int in_size,
 		     int (*fill)(void *dest, unsigned int size),
@@ -249,6 +251,8 @@ STATIC int decompress_unxz(unsigned char *in, int in_size,
 
 	if (fill == NULL && flush == NULL)
 		s = xz_dec_init(XZ_SINGLE, 0);
+	else if (flush == NULL)
+		s = xz_dec_init(XZ_OUTDICT, 0);
 	else
 		s = xz_dec_init(XZ_DYNALLOC, (uint32_t)-1);
 
@@ -0,0 +1,233 @@
+/*
+ * image-delta.c - update an installed image with a delta image
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#define pr_fmt(fmt) "image-delta: " fmt
+
+#include <common.h>
+#include <fs.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <libfile.h>
+#include <digest.h>
+#include <image-sparse.h>
+#include <linux/sizes.h>
+
+#include "image-writer.h"
+
+/*
+ * hash the first size bytes of fn and compare them with hash
+ */
+static int delta_check_hash(const char *fn, loff_t size, const u8 *hash,
+			    void *buf, size_t bufsize)
+{
+	u8 h[DELTA_HASH_SZ];
+	struct digest *d;
+	int fd, ret = 0;
+
+	d = digest_alloc("sha256");
+	if (!d)
+		return -ENOSYS;
+
+	fd = open(fn, O_RDONLY);
+	if (fd < 0) {
+		ret = fd;
+		goto out;
+	}
+
+	digest_init(d);
+
+	while (size) {
+		size_t now = min_t(loff_t, bufsize, size);
+
+		ret = read_full(fd, buf, now);
+		if (ret < 0)
+			break;
+		if (ret != now) {
+			ret = -EIO;
+			break;
+		}
+
+		digest_update(d, buf, now);
+		size -= now;
+		ret = 0;
+
+		if (ctrlc()) {
+			ret = -EINTR;
+			break;
+		}
+	}
+
+	close(fd);
+
+	if (!ret) {
+		digest_final(d, h);
+		if (memcmp(h, hash, DELTA_HASH_SZ))
+			ret = -EBADMSG;
+	}
+out:
+	digest_free(d);
+
+	return ret;
+}
+
+static int delta_read(int fd, void *buf, size_t len)
+{
+	int ret;
+
+	ret = read_full(fd, buf, len);
+	if (ret < 0)
+		return ret;
+	if (ret != len)
+		return -EINVAL;
+
+	return 0;
+}
+
+/**
+ * write_delta_image - update an installed image with a delta image
+ * @image:	the delta image file
+ * @dst:	the device or file holding the base image
+ * @flags:	IMAGE_WRITE_* flags
+ *
+ * The first base_size bytes of @dst must match the base the delta has been
+ * created against. Only the changed blocks are written, the result is
+ * checked against the hash of the new image afterwards. @dst is updated in
+ * place, so it is neither erased nor truncated and IMAGE_WRITE_ERASE is
+ * ignored: delta images are meant for block devices.
+ *
+ * Return: 0 for success, -EBADMSG if @dst doesn't hold the base or the
+ * result is wrong, another negative error code otherwise
+ */
+int write_delta_image(const char *image, const char *dst, unsigned flags)
+{
+	struct image_writer iw;
+	struct delta_header dh;
+	struct delta_chunk dc;
+	loff_t base_size, size, end = 0;
+	unsigned int blk_sz, i;
+	size_t bufsize;
+	void *buf;
+	int fd, ret;
+
+	fd = open(image, O_RDONLY);
+	if (fd < 0)
+		return fd;
+
+	ret = delta_read(fd, &dh, sizeof(dh));
+	if (ret)
+		goto out;
+
+	blk_sz = le32_to_cpu(dh.blk_sz);
+	base_size = le64_to_cpu(dh.base_size);
+	size = le64_to_cpu(dh.image_size);
+
+	if (le32_to_cpu(dh.magic) != DELTA_HEADER_MAGIC ||
+	    le16_to_cpu(dh.major_version) != 1 ||
+	    le16_to_cpu(dh.hdr_sz) < sizeof(dh) ||
+	    !blk_sz || blk_sz % 4) {
+		pr_err("%s: invalid delta image header\n", image);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (lseek(fd, le16_to_cpu(dh.hdr_sz), SEEK_SET) < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	buf = alloc_file_buf(IMAGE_WRITE_BUF_SIZE, &bufsize);
+
+	ret = delta_check_hash(dst, base_size, dh.base_hash, buf, bufsize);
+	if (ret == -EBADMSG &&
+	    !delta_check_hash(dst, size, dh.image_hash, buf, bufsize)) {
+		pr_info("%s is up to date\n", dst);
+		ret = 0;
+		free(buf);
+		goto out;
+	}
+
+	free(buf);
+
+	if (ret) {
+		if (ret == -EBADMSG)
+			pr_err("%s does not hold the base of %s\n", dst, image);
+		goto out;
+	}
+
+	flags &= ~IMAGE_WRITE_ERASE;
+
+	ret = image_writer_open(&iw, dst, size, flags | IMAGE_WRITE_KEEP);
+	if (ret)
+		goto out;
+
+	for (i = 0; i < le32_to_cpu(dh.total_chunks); i++) {
+		loff_t offset, len;
+		u32 val;
+
+		ret = delta_read(fd, &dc, sizeof(dc));
+		if (ret)
+			break;
+
+		offset = (loff_t)le64_to_cpu(dc.blk) * blk_sz;
+		len = (loff_t)le32_to_cpu(dc.nr_blks) * blk_sz;
+
+		if (offset < end || offset >= size) {
+			ret = -EINVAL;
+			break;
+		}
+
+		len = min(len, size - offset);
+
+		switch (le16_to_cpu(dc.chunk_type)) {
+		case CHUNK_TYPE_RAW:
+			ret = image_writer_copy(&iw, fd, offset, len, NULL);
+			break;
+		case CHUNK_TYPE_FILL:
+			ret = delta_read(fd, &val, sizeof(val));
+			if (!ret)
+				ret = image_writer_fill(&iw, offset, len, val);
+			break;
+		default:
+			pr_err("unknown chunk type 0x%04x\n",
+			       le16_to_cpu(dc.chunk_type));
+			ret = -EINVAL;
+			break;
+		}
+
+		if (ret)
+			break;
+
+		end = offset + len;
+	}
+
+	if (ret == -EINVAL)
+		pr_err("%s: invalid chunk %u\n", image, i);
+
+	if (!ret)
+		ret = image_writer_seek(&iw, size);
+
+	ret = image_writer_close(&iw, ret);
+	if (ret)
+		goto out;
+
+	buf = alloc_file_buf(IMAGE_WRITE_BUF_SIZE, &bufsize);
+	ret = delta_check_hash(dst, size, dh.image_hash, buf, bufsize);
+	free(buf);
+
+	if (ret == -EBADMSG)
+		pr_err("%s: hash mismatch after update\n", dst);
+out:
+	close(fd);
+
+	return ret;
+}
+EXPORT_SYMBOL(write_delta_image);
@@ -0,0 +1,593 @@
+/*
+ * image-sparse.c - write Android sparse images and block mapped images
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#define pr_fmt(fmt) "image-sparse: " fmt
+
+#include <common.h>
+#include <fs.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <libfile.h>
+#include <progress.h>
+#include <digest.h>
+#include <image-sparse.h>
+#include <linux/stat.h>
+#include <linux/sizes.h>
+#include <linux/ctype.h>
+
+#include "image-writer.h"
+
+int image_writer_open(struct image_writer *iw, const char *dst,
+		      loff_t size, unsigned flags)
+{
+	struct stat s;
+	int mode = O_WRONLY;
+	int ret;
+
+	memset(iw, 0, sizeof(*iw));
+
+	ret = stat(dst, &s);
+	if (ret && (flags & IMAGE_WRITE_KEEP)) {
+		return ret;
+	} else if (ret) {
+		mode |= O_CREAT;
+		iw->is_reg = true;
+	} else if (S_ISREG(s.st_mode) && !(flags & IMAGE_WRITE_KEEP)) {
+		mode |= O_TRUNC;
+		iw->is_reg = true;
+	} else if (s.st_size < size) {
+		pr_err("image (%lld bytes) is too big for %s (%lld bytes)\n",
+		       size, dst, s.st_size);
+		return -ENOSPC;
+	}
+
+	iw->fd = open(dst, mode);
+	if (iw->fd < 0)
+		return iw->fd;
+
+	if ((flags & IMAGE_WRITE_ERASE) && !iw->is_reg) {
+		ret = protect(iw->fd, size, 0, 0);
+		if (ret && ret != -ENOSYS) {
+			pr_err("unprotecting %s failed: %s\n", dst,
+			       strerror(-ret));
+			close(iw->fd);
+			return ret;
+		}
+
+		ret = erase(iw->fd, size, 0);
+		if (ret && ret != -ENOSYS) {
+			pr_err("erasing %s failed: %s\n", dst, strerror(-ret));
+			close(iw->fd);
+			return ret;
+		}
+	}
+
+	iw->size = size;
+	iw->flags = flags;
+	iw->buf = alloc_file_buf(IMAGE_WRITE_BUF_SIZE, &iw->bufsize);
+
+	if (flags & IMAGE_WRITE_VERBOSE) {
+		while ((size >> iw->shift) > INT_MAX)
+			iw->shift++;
+		init_progression_bar(size >> iw->shift);
+	}
+
+	return 0;
+}
+
+void image_writer_progress(struct image_writer *iw)
+{
+	if (iw->flags & IMAGE_WRITE_VERBOSE)
+		show_progress(iw->pos >> iw->shift);
+}
+
+int image_writer_write(struct image_writer *iw, const void *buf,
+		       size_t len)
+{
+	int ret;
+
+	ret = write_full(iw->fd, buf, len);
+	if (ret < 0)
+		return ret;
+	if (ret != len)
+		return -EIO;
+
+	iw->pos += len;
+
+	return 0;
+}
+
+int image_writer_seek(struct image_writer *iw, loff_t offset)
+{
+	int ret;
+
+	if (offset == iw->pos)
+		return 0;
+
+	if (iw->is_reg && offset > iw->pos) {
+		/* no holes in files, fill the gap with zeros */
+		memset(iw->buf, 0, iw->bufsize);
+
+		while (iw->pos < offset) {
+			size_t now = min_t(loff_t, iw->bufsize,
+					   offset - iw->pos);
+
+			ret = image_writer_write(iw, iw->buf, now);
+			if (ret)
+				return ret;
+		}
+
+		return 0;
+	}
+
+	if (lseek(iw->fd, offset, SEEK_SET) != offset)
+		return -errno;
+
+	iw->pos = offset;
+	image_writer_progress(iw);
+
+	return 0;
+}
+
+/*
+ * copy len bytes from the current position of srcfd to offset, optionally
+ * updating digest d with the data.
+ */
+int image_writer_copy(struct image_writer *iw, int srcfd,
+		      loff_t offset, loff_t len, struct digest *d)
+{
+	int ret;
+
+	ret = image_writer_seek(iw, offset);
+	if (ret)
+		return ret;
+
+	while (len) {
+		size_t now = min_t(loff_t, iw->bufsize, len);
+
+		ret = read_full(srcfd, iw->buf, now);
+		if (ret < 0)
+			return ret;
+		if (ret != now) {
+			pr_err("image is truncated\n");
+			return -EINVAL;
+		}
+
+		if (d)
+			digest_update(d, iw->buf, now);
+
+		ret = image_writer_write(iw, iw->buf, now);
+		if (ret)
+			return ret;
+
+		len -= now;
+
+		image_writer_progress(iw);
+
+		if (ctrlc())
+			return -EINTR;
+	}
+
+	return 0;
+}
+
+int image_writer_fill(struct image_writer *iw, loff_t offset,
+		      loff_t len, u32 fill)
+{
+	u32 *p = iw->buf;
+	int i, ret;
+
+	ret = image_writer_seek(iw, offset);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < iw->bufsize / sizeof(u32); i++)
+		p[i] = fill;
+
+	while (len) {
+		size_t now = min_t(loff_t, iw->bufsize, len);
+
+		ret = image_writer_write(iw, iw->buf, now);
+		if (ret)
+			return ret;
+
+		len -= now;
+
+		image_writer_progress(iw);
+
+		if (ctrlc())
+			return -EINTR;
+	}
+
+	return 0;
+}
+
+int image_writer_close(struct image_writer *iw, int ret)
+{
+	/* files get the full size of the image */
+	if (!ret && iw->is_reg)
+		ret = image_writer_seek(iw, iw->size);
+
+	if (iw->flags & IMAGE_WRITE_VERBOSE)
+		putchar('\n');
+
+	free(iw->buf);
+
+	if ((iw->flags & IMAGE_WRITE_ERASE) && !iw->is_reg)
+		protect(iw->fd, iw->size, 0, 1);
+
+	if (close(iw->fd) && !ret)
+		ret = -errno;
+
+	return ret;
+}
+
+static int sparse_read(int fd, void *buf, size_t len)
+{
+	int ret;
+
+	ret = read_full(fd, buf, len);
+	if (ret < 0)
+		return ret;
+	if (ret != len)
+		return -EINVAL;
+
+	return 0;
+}
+
+/**
+ * write_sparse_image - write an Android sparse image
+ * @image:	the sparse image file
+ * @dst:	the device or file to write to
+ * @flags:	IMAGE_WRITE_* flags
+ *
+ * Only the raw and fill chunks of the image are written, the destination
+ * is left untouched where the image doesn't care.
+ *
+ * Return: 0 for success or a negative error code
+ */
+int write_sparse_image(const char *image, const char *dst, unsigned flags)
+{
+	struct image_writer iw;
+	struct sparse_header sh;
+	struct chunk_header ch;
+	unsigned int blk_sz, i;
+	loff_t size, offset = 0;
+	int fd, ret;
+
+	fd = open(image, O_RDONLY);
+	if (fd < 0)
+		return fd;
+
+	ret = sparse_read(fd, &sh, sizeof(sh));
+	if (ret)
+		goto out;
+
+	blk_sz = le32_to_cpu(sh.blk_sz);
+
+	if (le32_to_cpu(sh.magic) != SPARSE_HEADER_MAGIC ||
+	    le16_to_cpu(sh.major_version) != 1 ||
+	    le16_to_cpu(sh.file_hdr_sz) < sizeof(sh) ||
+	    le16_to_cpu(sh.chunk_hdr_sz) < sizeof(ch) ||
+	    !blk_sz || blk_sz % 4) {
+		pr_err("%s: invalid sparse image header\n", image);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (lseek(fd, le16_to_cpu(sh.file_hdr_sz), SEEK_SET) < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	size = (loff_t)le32_to_cpu(sh.total_blks) * blk_sz;
+
+	ret = image_writer_open(&iw, dst, size, flags);
+	if (ret)
+		goto out;
+
+	for (i = 0; i < le32_to_cpu(sh.total_chunks); i++) {
+		loff_t len, datalen;
+		u32 val;
+
+		ret = sparse_read(fd, &ch, sizeof(ch));
+		if (ret)
+			break;
+
+		if (le16_to_cpu(sh.chunk_hdr_sz) > sizeof(ch) &&
+		    lseek(fd, le16_to_cpu(sh.chunk_hdr_sz) - sizeof(ch),
+			  SEEK_CUR) < 0) {
+			ret = -errno;
+			break;
+		}
+
+		len = (loff_t)le32_to_cpu(ch.chunk_sz) * blk_sz;
+		datalen = (loff_t)le32_to_cpu(ch.total_sz) -
+			  le16_to_cpu(sh.chunk_hdr_sz);
+
+		if (offset + len > size) {
+			ret = -EINVAL;
+			break;
+		}
+
+		switch (le16_to_cpu(ch.chunk_type)) {
+		case CHUNK_TYPE_RAW:
+			if (datalen != len) {
+				ret = -EINVAL;
+				break;
+			}
+			ret = image_writer_copy(&iw, fd, offset, len, NULL);
+			break;
+		case CHUNK_TYPE_FILL:
+			if (datalen != sizeof(val)) {
+				ret = -EINVAL;
+				break;
+			}
+			ret = sparse_read(fd, &val, sizeof(val));
+			if (!ret)
+				ret = image_writer_fill(&iw, offset, len, val);
+			break;
+		case CHUNK_TYPE_DONT_CARE:
+			if (datalen)
+				ret = -EINVAL;
+			break;
+		case CHUNK_TYPE_CRC32:
+			if (datalen != sizeof(val) || len) {
+				ret = -EINVAL;
+				break;
+			}
+			ret = sparse_read(fd, &val, sizeof(val));
+			break;
+		default:
+			pr_err("unknown chunk type 0x%04x\n",
+			       le16_to_cpu(ch.chunk_type));
+			ret = -EINVAL;
+			break;
+		}
+
+		if (ret)
+			break;
+
+		offset += len;
+	}
+
+	if (ret == -EINVAL)
+		pr_err("%s: invalid chunk %u\n", image, i);
+
+	ret = image_writer_close(&iw, ret);
+out:
+	close(fd);
+
+	return ret;
+}
+EXPORT_SYMBOL(write_sparse_image);
+
+/*
+ * The block map is an XML file created by bmaptool, see
+ * https://github.com/intel/bmap-tools. Only the few elements needed here
+ * are picked from it, there is no need for a full XML parser.
+ */
+static char *bmap_find_elem(char *xml, const char *name)
+{
+	char tag[32];
+	char *p;
+
+	snprintf(tag, sizeof(tag), "<%s>", name);
+
+	p = strstr(xml, tag);
+	if (!p)
+		return NULL;
+
+	p += strlen(tag);
+	while (isspace(*p))
+		p++;
+
+	return p;
+}
+
+static int bmap_get_ull(char *xml, const char *name, unsigned long long *val)
+{
+	char *p, *end;
+
+	p = bmap_find_elem(xml, name);
+	if (!p)
+		return -EINVAL;
+
+	*val = simple_strtoull(p, &end, 10);
+	if (end == p)
+		return -EINVAL;
+
+	return 0;
+}
+
+static struct digest *bmap_get_digest(char *xml)
+{
+	struct digest *d;
+	char name[16];
+	char *p;
+	int i;
+
+	p = bmap_find_elem(xml, "ChecksumType");
+	if (p) {
+		for (i = 0; i < sizeof(name) - 1 && isalnum(p[i]); i++)
+			name[i] = tolower(p[i]);
+		name[i] = 0;
+	} else {
+		/* bmap format 1.x always uses sha1 */
+		strcpy(name, "sha1");
+	}
+
+	d = digest_alloc(name);
+	if (!d)
+		pr_warn("no %s support, not verifying the image\n", name);
+
+	return d;
+}
+
+static int bmap_check_range(struct digest *d, const char *chksum,
+			    unsigned long long first, unsigned long long last)
+{
+	unsigned char ref[64], hash[64];
+	unsigned int len = digest_length(d);
+
+	if (!chksum)
+		return 0;
+
+	if (len > sizeof(ref) || hex2bin(ref, chksum, len))
+		return -EINVAL;
+
+	digest_final(d, hash);
+
+	if (memcmp(hash, ref, len)) {
+		pr_err("checksum mismatch in blocks %llu-%llu\n", first, last);
+		return -EBADMSG;
+	}
+
+	return 0;
+}
+
+/**
+ * write_bmap_image - write the mapped ranges of an image
+ * @image:	the full image file
+ * @bmap:	the block map of @image
+ * @dst:	the device or file to write to
+ * @flags:	IMAGE_WRITE_* flags
+ *
+ * Only the ranges listed in @bmap are written. When @bmap contains
+ * checksums and the digest is available, they are verified while the
+ * ranges are written.
+ *
+ * Return: 0 for success or a negative error code
+ */
+int write_bmap_image(const char *image, const char *bmap, const char *dst,
+		     unsigned flags)
+{
+	struct image_writer iw;
+	struct digest *d;
+	unsigned long long image_size, block_size;
+	char *xml, *p;
+	int fd, ret;
+
+	xml = read_file(bmap, NULL);
+	if (!xml)
+		return -errno;
+
+	if (bmap_get_ull(xml, "ImageSize", &image_size) ||
+	    bmap_get_ull(xml, "BlockSize", &block_size) || !block_size ||
+	    !(p = bmap_find_elem(xml, "BlockMap"))) {
+		pr_err("%s: invalid block map\n", bmap);
+		free(xml);
+		return -EINVAL;
+	}
+
+	fd = open(image, O_RDONLY);
+	if (fd < 0) {
+		free(xml);
+		return fd;
+	}
+
+	d = bmap_get_digest(xml);
+
+	ret = image_writer_open(&iw, dst, image_size, flags);
+	if (ret)
+		goto out;
+
+	while ((p = strstr(p, "<Range"))) {
+		unsigned long long first, last;
+		loff_t start, end;
+		char *tag_end, *chksum = NULL, *num, *e;
+
+		tag_end = strchr(p, '>');
+		if (!tag_end) {
+			ret = -EINVAL;
+			break;
+		}
+
+		*tag_end = 0;
+		chksum = strstr(p, "chksum=\"");
+		if (chksum)
+			chksum += strlen("chksum=\"");
+		*tag_end = '>';
+
+		/* bmaptool writes the range as "<Range ...> 0-1 </Range>" */
+		num = skip_spaces(tag_end + 1);
+		first = simple_strtoull(num, &e, 10);
+		last = first;
+		e = skip_spaces(e);
+		if (*e == '-')
+			last = simple_strtoull(skip_spaces(e + 1), &e, 10);
+		e = skip_spaces(e);
+
+		if (e == num || *e != '<' || last < first) {
+			ret = -EINVAL;
+			break;
+		}
+
+		start = first * block_size;
+		end = min_t(loff_t, (last + 1) * block_size, image_size);
+		if (start >= end) {
+			ret = -EINVAL;
+			break;
+		}
+
+		if (lseek(fd, start, SEEK_SET) != start) {
+			ret = -errno;
+			break;
+		}
+
+		if (d)
+			digest_init(d);
+
+		ret = image_writer_copy(&iw, fd, start, end - start, d);
+		if (!ret && d)
+			ret = bmap_check_range(d, chksum, first, last);
+		if (ret)
+			break;
+
+		p = e;
+	}
+
+	if (ret == -EINVAL)
+		pr_err("%s: invalid range\n", bmap);
+
+	ret = image_writer_close(&iw, ret);
+out:
+	if (d)
+		digest_free(d);
+	close(fd);
+	free(xml);
+
+	return ret;
+}
+EXPORT_SYMBOL(write_bmap_image);
+
+/**
+ * image_find_bmap - find the block map of an image
+ * @image:	the image file
+ *
+ * Return: the name of the block map file next to @image or NULL if there
+ * is none. The name must be freed by the caller.
+ */
+char *image_find_bmap(const char *image)
+{
+	struct stat s;
+	char *bmap;
+
+	bmap = basprintf("%s.bmap", image);
+	if (!stat(bmap, &s) && S_ISREG(s.st_mode))
+		return bmap;
+
+	free(bmap);
+
+	return NULL;
+}
+EXPORT_SYMBOL(image_find_bmap);
@@ -0,0 +1,40 @@
+#ifndef __IMAGE_WRITER_H
+#define __IMAGE_WRITER_H
+
+#include <linux/types.h>
+
+struct digest;
+
+#define IMAGE_WRITE_BUF_SIZE	SZ_1M
+
+/* private: update the destination in place, don't truncate or extend it */
+#define IMAGE_WRITE_KEEP	(1 << 16)
+
+/*
+ * The image formats describe an image as ranges with data and ranges which
+ * don't matter. struct image_writer writes the ranges with data to the
+ * destination and seeks over the others.
+ */
+struct image_writer {
+	int fd;
+	bool is_reg;		/* regular file, can't seek beyond its end */
+	loff_t pos;
+	loff_t size;
+	int shift;
+	unsigned flags;
+	void *buf;
+	size_t bufsize;
+};
+
+int image_writer_open(struct image_writer *iw, const char *dst, loff_t size,
+		      unsigned flags);
+void image_writer_progress(struct image_writer *iw);
+int image_writer_write(struct image_writer *iw, const void *buf, size_t len);
+int image_writer_seek(struct image_writer *iw, loff_t offset);
+int image_writer_copy(struct image_writer *iw, int srcfd, loff_t offset,
+		      loff_t len, struct digest *d);
+int image_writer_fill(struct image_writer *iw, loff_t offset, loff_t len,
+		      u32 fill);
+int image_writer_close(struct image_writer *iw, int ret);
+
+#endif /* __IMAGE_WRITER_H */
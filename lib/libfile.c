@@ -15,11 +15,16 @@
  *
  */
 #include <common.h>
+#include <dma.h>
 #include <fs.h>
 #include <fcntl.h>
 #include <malloc.h>
 #include <libfile.h>
 #include <progress.h>
+#include <ioctl.h>
+#include <linux/log2.h>
+#include <linux/sizes.h>
+#include <linux/mtd/mtd-abi.h>
 #include <linux/stat.h>
 
 /*
@@ -249,33 +254,138 @@ int write_file(const char *filename, void *buf, size_t size)
 }
 EXPORT_SYMBOL(write_file);
 
+/*
+ * copy_file() works through a large buffer, the number of read() and
+ * write() calls is what limits copying to fast media. Smaller buffers are
+ * used when memory is tight.
+ */
+#define COPY_FILE_BUF_SIZE	(CONFIG_COPY_FILE_BUF_SIZE * SZ_1K)
+
+/**
+ * alloc_file_buf - allocate a buffer for reading and writing files
+ * @maxsize:	the preferred size of the buffer
+ * @size:	output: the size of the buffer allocated
+ *
+ * File transfers are limited by the number of read() and write() calls, so
+ * they work best through a large buffer. When @maxsize bytes are not
+ * available, smaller buffers down to RW_BUF_SIZE are tried. The buffer is
+ * aligned for DMA so that the block layer can transfer it to the device
+ * directly.
+ *
+ * Return: the buffer, to be freed with free()
+ */
+void *alloc_file_buf(size_t maxsize, size_t *size)
+{
+	void *buf;
+
+	for (*size = maxsize; *size > RW_BUF_SIZE; *size >>= 1) {
+		buf = memalign(DMA_ALIGNMENT, *size);
+		if (buf)
+			return buf;
+	}
+
+	*size = RW_BUF_SIZE;
+
+	return xmemalign(DMA_ALIGNMENT, *size);
+}
+EXPORT_SYMBOL(alloc_file_buf);
+
+/*
+ * Writing 0xff to NOR or NAND flash does not change its contents, so
+ * all-0xff blocks can be skipped on these. Returns the granularity in
+ * which blocks may be skipped or 0 if they can't be skipped.
+ */
+static size_t copy_file_skip_size(int fd, size_t bufsize)
+{
+	struct mtd_info_user info;
+	size_t size;
+
+	if (!IS_ENABLED(CONFIG_MTD))
+		return 0;
+
+	if (ioctl(fd, MEMGETINFO, &info))
+		return 0;
+
+	if (info.type != MTD_NORFLASH && info.type != MTD_NANDFLASH)
+		return 0;
+
+	size = max_t(size_t, info.writesize, SZ_4K);
+	if (!is_power_of_2(size) || size > bufsize)
+		return 0;
+
+	return size;
+}
+
+static int copy_file_write(int fd, const void *buf, size_t len,
+			   size_t skip_size)
+{
+	while (len) {
+		size_t now = 0;
+		int ret;
+
+		/* skip a run of 0xff blocks */
+		while (skip_size && len - now >= skip_size &&
+		       !memchr_inv(buf + now, 0xff, skip_size))
+			now += skip_size;
+
+		if (now) {
+			if (lseek(fd, now, SEEK_CUR) < 0)
+				return -errno;
+			buf += now;
+			len -= now;
+			continue;
+		}
+
+		/* and write a run of blocks that contain data */
+		now = skip_size ? min(skip_size, len) : len;
+		while (now < len && (len - now < skip_size ||
+		       memchr_inv(buf + now, 0xff, skip_size)))
+			now += min(skip_size, len - now);
+
+		ret = write_full(fd, buf, now);
+		if (ret < 0)
+			return -errno;
+		if (!ret)
+			return -EIO;
+
+		buf += now;
+		len -= now;
+	}
+
+	return 0;
+}
+
 /**
  * copy_file - Copy a file
  * @src:	The source filename
  * @dst:	The destination filename
  * @verbose:	if true, show a progression bar
  *
+ * When @src or @dst can be memory mapped the data is copied from or to the
+ * mapping directly. All-0xff blocks are skipped when writing to flash.
+ *
  * Return: 0 for success or negative error code
  */
 int copy_file(const char *src, const char *dst, int verbose)
 {
-	char *rw_buf = NULL;
+	void *rw_buf = NULL, *srcmap = NULL, *dstmap = NULL;
 	int srcfd = 0, dstfd = 0;
-	int r, w;
-	int ret = 1, err1 = 0;
-	int mode;
-	void *buf;
-	int total = 0;
+	int ret, err1 = 0;
+	int mode, shift = 0;
+	size_t bufsize = 0, skip_size = 0;
+	loff_t srcsize = 0, total = 0;
 	struct stat srcstat, dststat;
 
-	rw_buf = xmalloc(RW_BUF_SIZE);
-
 	srcfd = open(src, O_RDONLY);
 	if (srcfd < 0) {
 		printf("could not open %s: %s\n", src, errno_str());
+		ret = -errno;
 		goto out;
 	}
 
+	if (!fstat(srcfd, &srcstat) && srcstat.st_size != FILESIZE_MAX)
+		srcsize = srcstat.st_size;
+
 	mode = O_WRONLY | O_CREAT;
 
 	ret = stat(dst, &dststat);
@@ -289,43 +399,85 @@ int copy_file(const char *src, const char *dst, int verbose)
 	dstfd = open(dst, mode);
 	if (dstfd < 0) {
 		printf("could not open %s: %s\n", dst, errno_str());
+		ret = -errno;
 		goto out;
 	}
 
-	if (verbose) {
-		if (stat(src, &srcstat) < 0)
-			srcstat.st_size = 0;
+	if (srcsize) {
+		srcmap = memmap(srcfd, PROT_READ);
+		if (srcmap == (void *)-1)
+			srcmap = NULL;
 
-		init_progression_bar(srcstat.st_size);
+		if (!ret && !S_ISREG(dststat.st_mode) &&
+		    dststat.st_size >= srcsize) {
+			dstmap = memmap(dstfd, PROT_READ | PROT_WRITE);
+			if (dstmap == (void *)-1)
+				dstmap = NULL;
+		}
+	}
+
+	if (!srcmap || !dstmap)
+		rw_buf = alloc_file_buf(COPY_FILE_BUF_SIZE, &bufsize);
+	else
+		bufsize = COPY_FILE_BUF_SIZE;
+
+	if (!dstmap)
+		skip_size = copy_file_skip_size(dstfd, bufsize);
+
+	if (verbose) {
+		/* the progression bar counts in int */
+		while ((srcsize >> shift) > INT_MAX)
+			shift++;
+		init_progression_bar(srcsize >> shift);
 	}
 
 	while (1) {
-		r = read(srcfd, rw_buf, RW_BUF_SIZE);
-		if (r < 0) {
-			perror("read");
-			goto out;
+		void *chunk;
+		size_t now = bufsize;
+
+		if (srcsize)
+			now = min_t(loff_t, now, srcsize - total);
+
+		if (srcmap) {
+			chunk = srcmap + total;
+		} else {
+			chunk = dstmap ? dstmap + total : rw_buf;
+			ret = read(srcfd, chunk, now);
+			if (ret < 0) {
+				perror("read");
+				ret = -errno;
+				goto out;
+			}
+			now = ret;
 		}
-		if (!r)
+
+		if (!now)
 			break;
 
-		buf = rw_buf;
-		while (r) {
-			w = write(dstfd, buf, r);
-			if (w < 0) {
-				perror("write");
+		if (dstmap) {
+			if (srcmap)
+				memcpy(dstmap + total, chunk, now);
+		} else {
+			ret = copy_file_write(dstfd, chunk, now, skip_size);
+			if (ret) {
+				printf("write: %s\n", strerror(-ret));
 				goto out;
 			}
-			buf += w;
-			r -= w;
-			total += w;
 		}
 
+		total += now;
+
 		if (verbose) {
-			if (srcstat.st_size && srcstat.st_size != FILESIZE_MAX)
-				show_progress(total);
+			if (srcsize)
+				show_progress(total >> shift);
 			else
 				show_progress(total / 16384);
 		}
+
+		if (ctrlc()) {
+			ret = -EINTR;
+			goto out;
+		}
 	}
 
 	ret = 0;
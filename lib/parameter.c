@@ -30,19 +30,70 @@
 #include <string.h>
 #include <globalvar.h>
 #include <linux/err.h>
+#include <mem_cache.h>
+
+/*
+ * All parameters of all devices are indexed by device and name. This keeps
+ * the lookups of global.* and nv.* variables cheap, the devices behind them
+ * carry many parameters.
+ */
+#define PARAM_HASH_SIZE	256
+static struct hlist_head param_hash[PARAM_HASH_SIZE];
+static unsigned long param_lookups, param_compares;
+
+static unsigned int param_hash_key(struct device_d *dev, const char *name)
+{
+	unsigned int hash = 5381 + ((unsigned long)dev >> 4);
+
+	while (*name)
+		hash = hash * 33 + *name++;
+
+	return hash % PARAM_HASH_SIZE;
+}
 
 struct param_d *get_param_by_name(struct device_d *dev, const char *name)
 {
 	struct param_d *p;
+	struct hlist_node *n;
 
-	list_for_each_entry(p, &dev->parameters, list) {
-		if (!strcmp(p->name, name))
+	param_lookups++;
+
+	hlist_for_each_entry(p, n, &param_hash[param_hash_key(dev, name)], hash) {
+		param_compares++;
+		if (p->dev == dev && !strcmp(p->name, name))
 			return p;
 	}
 
 	return NULL;
 }
 
+void param_print_lookup_stats(void)
+{
+	printf("parameter lookups: %lu, name compares: %lu\n",
+	       param_lookups, param_compares);
+}
+
+/*
+ * Parameters are allocated from a cache per parameter type. The cache is
+ * remembered in the parameter so that it can be freed without knowing its
+ * type. All types embed struct param_d as their first member.
+ */
+static DEFINE_MEM_CACHE(param_d_cache, "param_d", sizeof(struct param_d));
+
+static void *param_alloc(struct mem_cache *cache)
+{
+	struct param_d *p = mem_cache_alloc(cache);
+
+	p->cache = cache;
+
+	return p;
+}
+
+static void param_free(struct param_d *p)
+{
+	mem_cache_free(p->cache, p);
+}
+
 /**
  * dev_get_param - get the value of a parameter
  * @param dev	The device
@@ -92,6 +143,8 @@ int dev_set_param(struct device_d *dev, const char *name, const char *val)
 	ret = param->set(dev, param, val);
 	if (ret)
 		errno = -ret;
+	else
+		dev->param_generation++;
 
 	return ret;
 }
@@ -156,6 +209,8 @@ static int __dev_add_param(struct param_d *param, struct device_d *dev, const ch
 	param->flags = flags;
 	param->dev = dev;
 	list_add_sort(&param->list, &dev->parameters, compare);
+	hlist_add_head(&param->hash, &param_hash[param_hash_key(dev, name)]);
+	dev->param_generation++;
 
 	dev_param_init_from_nv(dev, name);
 
@@ -183,11 +238,11 @@ struct param_d *dev_add_param(struct device_d *dev, const char *name,
 	struct param_d *param;
 	int ret;
 
-	param = xzalloc(sizeof(*param));
+	param = param_alloc(&param_d_cache);
 
 	ret = __dev_add_param(param, dev, name, set, get, flags);
 	if (ret) {
-		free(param);
+		param_free(param);
 		return ERR_PTR(ret);
 	}
 
@@ -205,11 +260,11 @@ int dev_add_param_fixed(struct device_d *dev, const char *name, const char *valu
 	struct param_d *param;
 	int ret;
 
-	param = xzalloc(sizeof(*param));
+	param = param_alloc(&param_d_cache);
 
 	ret = __dev_add_param(param, dev, name, NULL, NULL, PARAM_FLAG_RO);
 	if (ret) {
-		free(param);
+		param_free(param);
 		return ret;
 	}
 
@@ -225,6 +280,9 @@ struct param_string {
 	int (*get)(struct param_d *p, void *priv);
 };
 
+static DEFINE_MEM_CACHE(param_string_cache, "param_string",
+			sizeof(struct param_string));
+
 static inline struct param_string *to_param_string(struct param_d *p)
 {
 	return container_of(p, struct param_string, param);
@@ -278,7 +336,7 @@ struct param_d *dev_add_param_string(struct device_d *dev, const char *name,
 	struct param_d *p;
 	int ret;
 
-	ps = xzalloc(sizeof(*ps));
+	ps = param_alloc(&param_string_cache);
 	ps->value = value;
 	ps->set = set;
 	ps->get = get;
@@ -287,7 +345,7 @@ struct param_d *dev_add_param_string(struct device_d *dev, const char *name,
 
 	ret = __dev_add_param(p, dev, name, param_string_set, param_string_get, 0);
 	if (ret) {
-		free(ps);
+		param_free(&ps->param);
 		return ERR_PTR(ret);
 	}
 
@@ -304,6 +362,8 @@ struct param_int {
 	int (*get)(struct param_d *p, void *priv);
 };
 
+static DEFINE_MEM_CACHE(param_int_cache, "param_int", sizeof(struct param_int));
+
 static inline struct param_int *to_param_int(struct param_d *p)
 {
 	return container_of(p, struct param_int, param);
@@ -377,7 +437,7 @@ struct param_d *dev_add_param_int(struct device_d *dev, const char *name,
 	struct param_d *p;
 	int ret;
 
-	pi = xzalloc(sizeof(*pi));
+	pi = param_alloc(&param_int_cache);
 	pi->value = value;
 	pi->format = format;
 	pi->set = set;
@@ -387,7 +447,7 @@ struct param_d *dev_add_param_int(struct device_d *dev, const char *name,
 
 	ret = __dev_add_param(p, dev, name, param_int_set, param_int_get, 0);
 	if (ret) {
-		free(pi);
+		param_free(&pi->param);
 		return ERR_PTR(ret);
 	}
 
@@ -403,6 +463,9 @@ struct param_enum {
 	int (*get)(struct param_d *p, void *priv);
 };
 
+static DEFINE_MEM_CACHE(param_enum_cache, "param_enum",
+			sizeof(struct param_enum));
+
 static inline struct param_enum *to_param_enum(struct param_d *p)
 {
 	return container_of(p, struct param_enum, param);
@@ -484,7 +547,7 @@ struct param_d *dev_add_param_enum(struct device_d *dev, const char *name,
 	struct param_d *p;
 	int ret;
 
-	pe = xzalloc(sizeof(*pe));
+	pe = param_alloc(&param_enum_cache);
 
 	pe->value = value;
 	pe->set = set;
@@ -496,7 +559,7 @@ struct param_d *dev_add_param_enum(struct device_d *dev, const char *name,
 
 	ret = __dev_add_param(p, dev, name, param_enum_set, param_enum_get, 0);
 	if (ret) {
-		free(pe);
+		param_free(&pe->param);
 		return ERR_PTR(ret);
 	}
 
@@ -514,6 +577,9 @@ struct param_bitmask {
 	int (*get)(struct param_d *p, void *priv);
 };
 
+static DEFINE_MEM_CACHE(param_bitmask_cache, "param_bitmask",
+			sizeof(struct param_bitmask));
+
 static inline struct param_bitmask *to_param_bitmask(struct param_d *p)
 {
 	return container_of(p, struct param_bitmask, param);
@@ -613,7 +679,7 @@ struct param_d *dev_add_param_bitmask(struct device_d *dev, const char *name,
 	struct param_d *p;
 	int ret, i, len = 0;
 
-	pb = xzalloc(sizeof(*pb));
+	pb = param_alloc(&param_bitmask_cache);
 
 	pb->value = value;
 	pb->set = set;
@@ -631,7 +697,7 @@ struct param_d *dev_add_param_bitmask(struct device_d *dev, const char *name,
 
 	ret = __dev_add_param(p, dev, name, param_bitmask_set, param_bitmask_get, 0);
 	if (ret) {
-		free(pb);
+		param_free(&pb->param);
 		return ERR_PTR(ret);
 	}
 
@@ -690,11 +756,11 @@ struct param_d *dev_add_param_int_ro(struct device_d *dev, const char *name,
 	struct param_int *piro;
 	int ret;
 
-	piro = xzalloc(sizeof(*piro));
+	piro = param_alloc(&param_int_cache);
 
 	ret = __dev_add_param(&piro->param, dev, name, NULL, NULL, PARAM_FLAG_RO);
 	if (ret) {
-		free(piro);
+		param_free(&piro->param);
 		return ERR_PTR(ret);
 	}
 
@@ -716,11 +782,11 @@ struct param_d *dev_add_param_llint_ro(struct device_d *dev, const char *name,
 	struct param_int *piro;
 	int ret;
 
-	piro = xzalloc(sizeof(*piro));
+	piro = param_alloc(&param_int_cache);
 
 	ret = __dev_add_param(&piro->param, dev, name, NULL, NULL, PARAM_FLAG_RO);
 	if (ret) {
-		free(piro);
+		param_free(&piro->param);
 		return ERR_PTR(ret);
 	}
 
@@ -737,6 +803,8 @@ struct param_ip {
 	int (*get)(struct param_d *p, void *priv);
 };
 
+static DEFINE_MEM_CACHE(param_ip_cache, "param_ip", sizeof(struct param_ip));
+
 static inline struct param_ip *to_param_ip(struct param_d *p)
 {
 	return container_of(p, struct param_ip, param);
@@ -790,7 +858,7 @@ struct param_d *dev_add_param_ip(struct device_d *dev, const char *name,
 	struct param_ip *pi;
 	int ret;
 
-	pi = xzalloc(sizeof(*pi));
+	pi = param_alloc(&param_ip_cache);
 	pi->ip = ip;
 	pi->set = set;
 	pi->get = get;
@@ -799,7 +867,7 @@ struct param_d *dev_add_param_ip(struct device_d *dev, const char *name,
 	ret = __dev_add_param(&pi->param, dev, name,
 			param_ip_set, param_ip_get, 0);
 	if (ret) {
-		free(pi);
+		param_free(&pi->param);
 		return ERR_PTR(ret);
 	}
 
@@ -815,6 +883,8 @@ struct param_mac {
 	int (*get)(struct param_d *p, void *priv);
 };
 
+static DEFINE_MEM_CACHE(param_mac_cache, "param_mac", sizeof(struct param_mac));
+
 int string_to_ethaddr(const char *str, u8 enetaddr[6]);
 void ethaddr_to_string(const u8 enetaddr[6], char *str);
 
@@ -876,7 +946,7 @@ struct param_d *dev_add_param_mac(struct device_d *dev, const char *name,
 	struct param_mac *pm;
 	int ret;
 
-	pm = xzalloc(sizeof(*pm));
+	pm = param_alloc(&param_mac_cache);
 	pm->mac = mac;
 	pm->set = set;
 	pm->get = get;
@@ -886,7 +956,7 @@ struct param_d *dev_add_param_mac(struct device_d *dev, const char *name,
 	ret = __dev_add_param(&pm->param, dev, name,
 			param_mac_set, param_mac_get, 0);
 	if (ret) {
-		free(pm);
+		param_free(&pm->param);
 		return ERR_PTR(ret);
 	}
 
@@ -900,10 +970,12 @@ struct param_d *dev_add_param_mac(struct device_d *dev, const char *name,
  */
 void dev_remove_param(struct param_d *p)
 {
+	p->dev->param_generation++;
 	p->set(p->dev, p, NULL);
 	list_del(&p->list);
+	hlist_del(&p->hash);
 	free(p->name);
-	free(p);
+	param_free(p);
 }
 
 /**
@@ -918,8 +990,9 @@ void dev_remove_parameters(struct device_d *dev)
 	list_for_each_entry_safe(p, n, &dev->parameters, list) {
 		p->set(dev, p, NULL);
 		list_del(&p->list);
+		hlist_del(&p->hash);
 		free(p->name);
-		free(p);
+		param_free(p);
 	}
 }
 
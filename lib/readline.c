@@ -202,6 +202,7 @@ int readline(const char *prompt, char *buf, int len)
 	while (1) {
 		while (!tstc()) {
 			poller_call();
+			poller_work_run();
 			if (IS_ENABLED(CONFIG_RATP))
 				ratp_run_command();
 		}
@@ -22,6 +22,9 @@
 
 char * ___strtok;
 
+#define WORD_SIZE	sizeof(unsigned long)
+#define WORD_MASK	(WORD_SIZE - 1)
+
 #ifndef __HAVE_ARCH_STRNICMP
 /**
  * strnicmp - Case insensitive, length-limited string comparison
@@ -459,6 +462,57 @@ char *strswab(const char *s)
 }
 #endif
 
+#if !defined(__HAVE_ARCH_MEMCPY) || !defined(__HAVE_ARCH_MEMMOVE)
+/*
+ * Forward copy. This is safe for overlapping areas as long as
+ * dest <= src, so memmove() uses it as well.
+ */
+static void *memcpy_fwd(void *dest, const void *src, size_t count)
+{
+	unsigned char *tmp = dest;
+	const unsigned char *s = src;
+
+	/*
+	 * Copy word-wise when source and destination can be aligned at the
+	 * same time. Otherwise fall back to a byte copy, unaligned word
+	 * accesses may fault on some cores, especially with caches off.
+	 */
+	if (count >= 2 * WORD_SIZE &&
+	    !(((unsigned long)tmp ^ (unsigned long)s) & WORD_MASK)) {
+		unsigned long *wd;
+		const unsigned long *ws;
+
+		while ((unsigned long)tmp & WORD_MASK) {
+			*tmp++ = *s++;
+			count--;
+		}
+
+		wd = (unsigned long *)tmp;
+		ws = (const unsigned long *)s;
+
+		for (; count >= 4 * WORD_SIZE; count -= 4 * WORD_SIZE) {
+			wd[0] = ws[0];
+			wd[1] = ws[1];
+			wd[2] = ws[2];
+			wd[3] = ws[3];
+			wd += 4;
+			ws += 4;
+		}
+
+		for (; count >= WORD_SIZE; count -= WORD_SIZE)
+			*wd++ = *ws++;
+
+		tmp = (unsigned char *)wd;
+		s = (const unsigned char *)ws;
+	}
+
+	while (count--)
+		*tmp++ = *s++;
+
+	return dest;
+}
+#endif
+
 #ifndef __HAVE_ARCH_MEMSET
 /**
  * memset - Fill a region of memory with the given value
@@ -470,7 +524,33 @@ char *strswab(const char *s)
  */
 void * memset(void * s,int c,size_t count)
 {
-	char *xs = (char *) s;
+	unsigned char *xs = s;
+
+	if (count >= 2 * WORD_SIZE) {
+		unsigned long pattern = (~0UL / 0xff) * (unsigned char)c;
+		unsigned long *ws;
+
+		/* fill up to the first word boundary bytewise */
+		while ((unsigned long)xs & WORD_MASK) {
+			*xs++ = c;
+			count--;
+		}
+
+		ws = (unsigned long *)xs;
+
+		for (; count >= 4 * WORD_SIZE; count -= 4 * WORD_SIZE) {
+			ws[0] = pattern;
+			ws[1] = pattern;
+			ws[2] = pattern;
+			ws[3] = pattern;
+			ws += 4;
+		}
+
+		for (; count >= WORD_SIZE; count -= WORD_SIZE)
+			*ws++ = pattern;
+
+		xs = (unsigned char *)ws;
+	}
 
 	while (count--)
 		*xs++ = c;
@@ -492,12 +572,7 @@ EXPORT_SYMBOL(memset);
  */
 void * memcpy(void * dest,const void *src,size_t count)
 {
-	char *tmp = (char *) dest, *s = (char *) src;
-
-	while (count--)
-		*tmp++ = *s++;
-
-	return dest;
+	return memcpy_fwd(dest, src, count);
 }
 #endif
 EXPORT_SYMBOL(memcpy);
@@ -513,21 +588,39 @@ EXPORT_SYMBOL(memcpy);
  */
 void * memmove(void * dest,const void *src,size_t count)
 {
-	char *tmp, *s;
+	unsigned char *tmp;
+	const unsigned char *s;
 
-	if (dest <= src) {
-		tmp = (char *) dest;
-		s = (char *) src;
-		while (count--)
-			*tmp++ = *s++;
-		}
-	else {
-		tmp = (char *) dest + count;
-		s = (char *) src + count;
-		while (count--)
+	if (dest <= src)
+		return memcpy_fwd(dest, src, count);
+
+	/* dest above src, copy backwards in case the areas overlap */
+	tmp = (unsigned char *)dest + count;
+	s = (const unsigned char *)src + count;
+
+	if (count >= 2 * WORD_SIZE &&
+	    !(((unsigned long)tmp ^ (unsigned long)s) & WORD_MASK)) {
+		unsigned long *wd;
+		const unsigned long *ws;
+
+		while ((unsigned long)tmp & WORD_MASK) {
 			*--tmp = *--s;
+			count--;
 		}
 
+		wd = (unsigned long *)tmp;
+		ws = (const unsigned long *)s;
+
+		for (; count >= WORD_SIZE; count -= WORD_SIZE)
+			*--wd = *--ws;
+
+		tmp = (unsigned char *)wd;
+		s = (const unsigned char *)ws;
+	}
+
+	while (count--)
+		*--tmp = *--s;
+
 	return dest;
 }
 #endif
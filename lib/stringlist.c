@@ -3,6 +3,10 @@
 #include <malloc.h>
 #include <errno.h>
 #include <stringlist.h>
+#include <mem_cache.h>
+
+static DEFINE_MEM_CACHE(string_list_cache, "string_list",
+			sizeof(struct string_list));
 
 static int string_list_compare(struct list_head *a, struct list_head *b)
 {
@@ -17,7 +21,7 @@ int string_list_add(struct string_list *sl, const char *str)
 {
 	struct string_list *new;
 
-	new = xmalloc(sizeof(*new));
+	new = mem_cache_alloc(&string_list_cache);
 	new->str = xstrdup(str);
 
 	list_add_tail(&new->list, &sl->list);
@@ -30,7 +34,7 @@ int string_list_add_asprintf(struct string_list *sl, const char *fmt, ...)
 	struct string_list *new;
 	va_list args;
 
-	new = xmalloc(sizeof(*new));
+	new = mem_cache_alloc(&string_list_cache);
 
 	va_start(args, fmt);
 
@@ -39,7 +43,7 @@ int string_list_add_asprintf(struct string_list *sl, const char *fmt, ...)
 	va_end(args);
 
 	if (!new->str) {
-		free(new);
+		mem_cache_free(&string_list_cache, new);
 		return -ENOMEM;
 	}
 
@@ -52,7 +56,7 @@ int string_list_add_sorted(struct string_list *sl, const char *str)
 {
 	struct string_list *new;
 
-	new = xmalloc(sizeof(*new));
+	new = mem_cache_alloc(&string_list_cache);
 	new->str = xstrdup(str);
 
 	list_add_sort(&new->list, &sl->list, string_list_compare);
@@ -60,6 +64,16 @@ int string_list_add_sorted(struct string_list *sl, const char *str)
 	return 0;
 }
 
+void string_list_free(struct string_list *sl)
+{
+	struct string_list *entry, *safe;
+
+	list_for_each_entry_safe(entry, safe, &sl->list, list) {
+		free(entry->str);
+		mem_cache_free(&string_list_cache, entry);
+	}
+}
+
 int string_list_contains(struct string_list *sl, const char *str)
 {
 	struct string_list *entry;
@@ -36,12 +36,21 @@
 #include <environment.h>
 #include <digest.h>
 #include <globalvar.h>
+#include <progress.h>
+#include <linux/sizes.h>
+#include <filetype.h>
+#include <image-sparse.h>
+#include <rsa.h>
 
 #define SWU_MNT_PATH		"/tmp/swu/"
 #define BBU_FLAGS_VERBOSE	(1 << 31)
 #define CHKFILE_PREFIX		"md5sum"
 #define HASH_SZ			32
 #define DIGEST_ALG		"md5"
+#define SWU_BUF_SIZE		SZ_1M
+#define MANIFEST_DIGEST_ALG	"sha256"
+#define MANIFEST_HASH_SZ	32
+#define MANIFEST_KEY		"/signature/key-swu"
 
 #define LOGFILE		".update.log.tmp"
 #define swu_log(fmt, args...) \
@@ -90,6 +99,36 @@ static struct lvds_param_data lvds_params[] = {
 
 static struct swu_hook *status_hook;
 
+/**
+ * struct swu_manifest_entry - an image listed in the update manifest
+ * @path:	full path of the image on the update media
+ * @target:	device the image is meant for, NULL for any
+ * @size:	size of the image
+ * @hash:	sha256 of the image
+ */
+struct swu_manifest_entry {
+	struct list_head list;
+	char *path;
+	char *target;
+	loff_t size;
+	unsigned char hash[MANIFEST_HASH_SZ];
+};
+
+static LIST_HEAD(swu_manifest);
+static char *swu_manifest_dir;
+
+/**
+ * struct swu_ref - reference an image is checked against
+ * @d:		digest used for the check
+ * @hash:	expected hash, digest_length(d) bytes
+ * @size:	expected size, -1 if unknown
+ */
+struct swu_ref {
+	struct digest *d;
+	unsigned char hash[MANIFEST_HASH_SZ];
+	loff_t size;
+};
+
 static int ctoi(char character)
 {
 	if (character == '0')
@@ -146,6 +185,17 @@ static int swu_hfile_status(const char *ifn)
 	return ret;
 }
 
+static struct swu_manifest_entry *swu_manifest_find(const char *ifn)
+{
+	struct swu_manifest_entry *e;
+
+	list_for_each_entry(e, &swu_manifest, list)
+		if (!strcmp(e->path, ifn))
+			return e;
+
+	return NULL;
+}
+
 /**
  * calculate and compare hashes between buffer and file
  * "oh" should be freed by caller
@@ -257,7 +307,7 @@ int swu_check_buf_img(struct bbu_data *data, const char *ifn,  const char *ofn)
 	unsigned char *hash = NULL;
 	int ret = 0;
 
-	if (swu_hfile_status(ifn)) {
+	if (!swu_manifest_find(ifn) && swu_hfile_status(ifn)) {
 		pr_info("integrity check skipped %s.\n", ifn);
 		return 0;
 	}
@@ -276,35 +326,52 @@ int swu_check_buf_img(struct bbu_data *data, const char *ifn,  const char *ofn)
 	return ret;
 }
 
-/**
- * calculate and compare hashes using size of ifn and md5sum in file
- */
-static int swu_check_file_hash(const char *ifn, const char *ofn,
-			const unsigned char *hash)
+static int swu_check_limits(const char *ifn, const char *ofn)
 {
-	struct stat st;
+	struct stat si, so;
 
-	if (stat(ifn, &st))
+	if (!ifn || !ofn)
+		return -EINVAL;
+
+	if (stat(ifn, &si)) {
+		pr_debug("stat failed: %s\n", ifn);
 		return -ENOENT;
+	}
 
-	return swu_check_hash(ofn, st.st_size, 1, hash);
+	if (stat(ofn, &so)) {
+		pr_debug("stat failed: %s\n", ofn);
+		return -ENOENT;
+	}
+
+	if (so.st_size < si.st_size)
+		return -EINVAL;
+
+	return 0;
 }
 
 /**
- * get hash from checksum file and check integrity
+ * read the reference hash from the checksum file of ifn
+ * @param ifn - input file
+ * @param ref - output buffer for the binary hash, dlength bytes
+ * @return 0 on success, -ENOENT if there is no checksum file
  */
-static int swu_check_img_hash(const char *ifn, const char *ofn)
+static int swu_read_ref_hash(const char *ifn, unsigned char *ref,
+			unsigned int dlength)
 {
 	char hashfile[PATH_MAX];
-	int fd, ret;
-	char hash[HASH_SZ+2];
+	char hash[HASH_SZ + 1];
+	int fd, ret, i;
+
+	if (dlength * 2 != HASH_SZ)
+		return -EINVAL;
 
-	snprintf(hashfile, sizeof(hashfile)-1, "%s.md5sum", ifn);
+	snprintf(hashfile, sizeof(hashfile) - 1, "%s.md5sum", ifn);
 	fd = open(hashfile, O_RDONLY);
-	swu_log("hash file: %s\n", hashfile);
 	if (fd < 0)
 		return -ENOENT;
 
+	swu_log("hash file: %s\n", hashfile);
+
 	ret = read(fd, hash, HASH_SZ);
 	close(fd);
 
@@ -312,63 +379,627 @@ static int swu_check_img_hash(const char *ifn, const char *ofn)
 		return -EINVAL;
 
 	hash[HASH_SZ] = '\0';
-
 	swu_log(">hash: %s\n", hash);
-	ret = swu_check_file_hash(ifn, ofn, hash);
+
+	for (i = 0; i < dlength; i++) {
+		int hi = ctoi(hash[2 * i]);
+		int lo = ctoi(hash[2 * i + 1]);
+
+		if (hi < 0 || lo < 0)
+			return -EINVAL;
+
+		ref[i] = (hi << 4) | lo;
+	}
+
+	return 0;
+}
+
+static int swu_compare_hash(const unsigned char *h, const unsigned char *ref,
+			unsigned int dlength)
+{
+	int i;
+
+	swu_log("<hash: ");
+	for (i = 0; i < dlength; i++)
+		swu_log("%02x", h[i]);
+	swu_log("\n");
+
+	if (memcmp(h, ref, dlength)) {
+		swu_log("ERROR: signature check failed.\n");
+		return -EINVAL;
+	}
+
+	swu_log("signature check ok.\n");
+
+	return 0;
+}
+
+/**
+ * check the manifest signature
+ *
+ * Without a key in the device tree manifests are accepted unsigned. With a
+ * key the manifest must come with a valid <path>.sig, a RSA PKCS#1 v1.5
+ * signature of its sha256.
+ */
+static int swu_manifest_verify(const char *path, const void *buf, size_t len)
+{
+	struct device_node *key_node;
+	struct rsa_public_key key;
+	unsigned char hash[MANIFEST_HASH_SZ];
+	struct digest *d;
+	char *sigfile;
+	void *sig;
+	size_t siglen;
+	int ret;
+
+	key_node = of_find_node_by_path(MANIFEST_KEY);
+	if (!key_node) {
+		swu_log("no key %s, manifest not verified\n", MANIFEST_KEY);
+		return 0;
+	}
+
+	if (!IS_ENABLED(CONFIG_DMO_SWU_MANIFEST_SIGNATURE)) {
+		swu_log("ERROR: manifest signatures not supported\n");
+		return -ENOSYS;
+	}
+
+	ret = rsa_of_read_key(key_node, &key);
+	if (ret) {
+		swu_log("ERROR: cannot read key %s\n", MANIFEST_KEY);
+		return ret;
+	}
+
+	sigfile = basprintf("%s.sig", path);
+	sig = read_file(sigfile, &siglen);
+	free(sigfile);
+	if (!sig) {
+		swu_log("ERROR: manifest signature missing\n");
+		ret = -EPERM;
+		goto out_key;
+	}
+
+	d = digest_alloc(MANIFEST_DIGEST_ALG);
+	if (!d) {
+		ret = -ENOSYS;
+		goto out_sig;
+	}
+
+	ret = digest_digest(d, buf, len, hash);
+	if (!ret)
+		ret = rsa_verify(&key, sig, siglen, hash, HASH_ALGO_SHA256);
+	if (ret) {
+		swu_log("ERROR: manifest signature BAD\n");
+		ret = -EBADMSG;
+	} else {
+		swu_log("manifest signature OK\n");
+	}
+
+	digest_free(d);
+out_sig:
+	free(sig);
+out_key:
+	free(key.modulus);
+	free(key.rr);
 
 	return ret;
 }
 
-static int swu_check_limits(const char *ifn, const char *ofn)
+static char *swu_next_word(char **s)
 {
-	struct stat si, so;
+	char *word;
 
-	if (!ifn || !ofn)
+	word = skip_spaces(*s);
+	if (!*word)
+		return NULL;
+
+	*s = word;
+	while (**s && !isspace(**s))
+		(*s)++;
+	if (**s)
+		*(*s)++ = '\0';
+
+	return word;
+}
+
+/**
+ * parse a manifest line: <sha256> <size> <image> [<target>]
+ */
+static int swu_manifest_parse_line(const char *dir, char *line)
+{
+	struct swu_manifest_entry *e;
+	char *hash, *size, *image, *target, *end;
+
+	hash = swu_next_word(&line);
+	if (!hash || *hash == '#')
+		return 0;
+
+	size = swu_next_word(&line);
+	image = swu_next_word(&line);
+	target = swu_next_word(&line);
+
+	if (!size || !image || strlen(hash) != 2 * MANIFEST_HASH_SZ)
 		return -EINVAL;
 
-	if (stat(ifn, &si)) {
-		pr_debug("stat failed: %s\n", ifn);
-		return -ENOENT;
+	e = xzalloc(sizeof(*e));
+
+	if (hex2bin(e->hash, hash, MANIFEST_HASH_SZ))
+		goto err;
+
+	e->size = simple_strtoull(size, &end, 0);
+	if (*end)
+		goto err;
+
+	e->path = concat_path_file(dir, image);
+	if (target)
+		e->target = xstrdup(target);
+
+	list_add_tail(&e->list, &swu_manifest);
+
+	return 0;
+err:
+	free(e);
+	return -EINVAL;
+}
+
+void swu_manifest_free(void)
+{
+	struct swu_manifest_entry *e, *tmp;
+
+	list_for_each_entry_safe(e, tmp, &swu_manifest, list) {
+		list_del(&e->list);
+		free(e->path);
+		free(e->target);
+		free(e);
 	}
 
-	if (stat(ofn, &so)) {
-		pr_debug("stat failed: %s\n", ofn);
+	free(swu_manifest_dir);
+	swu_manifest_dir = NULL;
+}
+
+/**
+ * load the update manifest
+ * @param path - manifest file, the images it lists are relative to its
+ *		 directory
+ * @return 0 on success, -ENOENT if there is no manifest
+ *
+ * Each line of the manifest lists the sha256, the size, the name and
+ * optionally the target device of an image. Once a manifest is loaded
+ * all images from its directory must be listed in it and are checked
+ * against it instead of their md5sum files. With a key in the device tree
+ * the manifest is mandatory: a missing one is an error, not -ENOENT, so
+ * the images are never checked against their unsigned md5sum files.
+ */
+int swu_manifest_load(const char *path)
+{
+	char *buf, *line, *next, *dir, *tmp;
+	size_t size;
+	int ret, lineno = 0;
+
+	swu_manifest_free();
+
+	buf = read_file(path, &size);
+	if (!buf) {
+		if (of_find_node_by_path(MANIFEST_KEY)) {
+			swu_log("ERROR: manifest missing, %s requires one\n",
+					MANIFEST_KEY);
+			return -EPERM;
+		}
 		return -ENOENT;
 	}
 
-	if (so.st_size < si.st_size)
+	swu_log("manifest: %s\n", path);
+
+	ret = swu_manifest_verify(path, buf, size);
+	if (ret)
+		goto out;
+
+	tmp = xstrdup(path);
+	dir = xstrdup(dirname(tmp));
+	free(tmp);
+
+	for (line = buf; line; line = next) {
+		next = strchr(line, '\n');
+		if (next)
+			*next++ = '\0';
+		lineno++;
+
+		ret = swu_manifest_parse_line(dir, line);
+		if (ret) {
+			swu_log("ERROR: manifest line %d invalid\n", lineno);
+			break;
+		}
+	}
+
+	if (ret) {
+		free(dir);
+		swu_manifest_free();
+	} else {
+		swu_manifest_dir = dir;
+	}
+out:
+	free(buf);
+
+	return ret;
+}
+
+/**
+ * check that the manifest allows writing ifn to dev
+ */
+static int swu_manifest_check_target(const char *ifn, const char *dev)
+{
+	struct swu_manifest_entry *e = swu_manifest_find(ifn);
+
+	if (!e || !e->target)
+		return 0;
+
+	if (!strncmp(dev, "/dev/", 5))
+		dev += 5;
+
+	if (strcmp(dev, e->target)) {
+		swu_log("ERROR: %s is for %s, not %s\n", ifn, e->target, dev);
+		return -EPERM;
+	}
+
+	return 0;
+}
+
+/**
+ * get the reference hash for ifn
+ *
+ * Images on the update media are looked up in the manifest if one is
+ * loaded, all other images fall back to their md5sum file.
+ * @return 0 on success, -ENOENT if ifn has no reference hash
+ */
+static int swu_get_ref(const char *ifn, struct swu_ref *ref)
+{
+	struct swu_manifest_entry *e;
+	size_t len = swu_manifest_dir ? strlen(swu_manifest_dir) : 0;
+	int ret;
+
+	ref->d = NULL;
+	ref->size = -1;
+
+	if (swu_manifest_dir && !strncmp(ifn, swu_manifest_dir, len) &&
+			ifn[len] == '/') {
+		e = swu_manifest_find(ifn);
+		if (!e) {
+			swu_log("ERROR: %s not in manifest\n", ifn);
+			return -EPERM;
+		}
+
+		ref->d = digest_alloc(MANIFEST_DIGEST_ALG);
+		if (!ref->d)
+			return -ENOSYS;
+
+		memcpy(ref->hash, e->hash, MANIFEST_HASH_SZ);
+		ref->size = e->size;
+
+		return 0;
+	}
+
+	if (swu_hfile_status(ifn))
+		return -ENOENT;
+
+	ref->d = digest_alloc(DIGEST_ALG);
+	if (!ref->d)
+		return -ENOSYS;
+
+	ret = swu_read_ref_hash(ifn, ref->hash, digest_length(ref->d));
+	if (ret) {
+		digest_free(ref->d);
+		ref->d = NULL;
 		return -EINVAL;
+	}
 
 	return 0;
 }
 
+static void swu_put_ref(struct swu_ref *ref)
+{
+	if (ref->d)
+		digest_free(ref->d);
+}
+
+/**
+ * copy ifn to ofn in one pass, hashing the data on the way
+ * @param oflags - flags ofn is opened with
+ * @param d - digest updated with the copied data, may be NULL
+ * @param total - output: number of bytes copied
+ */
+static int swu_copy_hashed(const char *ifn, const char *ofn, int oflags,
+			struct digest *d, void *buf, size_t bufsize,
+			loff_t *total, int verbose)
+{
+	int srcfd, dstfd, ret = 0;
+	struct stat st;
+	loff_t copied = 0;
+
+	srcfd = open(ifn, O_RDONLY);
+	if (srcfd < 0)
+		return srcfd;
+
+	dstfd = open(ofn, oflags);
+	if (dstfd < 0) {
+		close(srcfd);
+		return dstfd;
+	}
+
+	if (verbose) {
+		if (fstat(srcfd, &st))
+			st.st_size = 0;
+		init_progression_bar(st.st_size >> 10);
+	}
+
+	while (1) {
+		int r, w;
+		void *p = buf;
+
+		r = read(srcfd, buf, bufsize);
+		if (r < 0) {
+			ret = r;
+			break;
+		}
+		if (!r)
+			break;
+
+		if (d) {
+			ret = digest_update(d, buf, r);
+			if (ret)
+				break;
+		}
+
+		while (r) {
+			w = write(dstfd, p, r);
+			if (w < 0) {
+				ret = w;
+				goto out;
+			}
+			p += w;
+			r -= w;
+			copied += w;
+		}
+
+		if (verbose)
+			show_progress(copied >> 10);
+
+		if (ctrlc()) {
+			ret = -EINTR;
+			break;
+		}
+	}
+out:
+	if (verbose)
+		putchar('\n');
+
+	close(srcfd);
+	if (close(dstfd) && !ret)
+		ret = -EIO;
+
+	*total = copied;
+
+	return ret;
+}
+
+/**
+ * hash the first size bytes of fn with large reads
+ */
+static int swu_hash_window(const char *fn, struct digest *d, loff_t size,
+			void *buf, size_t bufsize)
+{
+	int fd, ret = 0;
+
+	fd = open(fn, O_RDONLY);
+	if (fd < 0)
+		return fd;
+
+	while (size) {
+		int now = read(fd, buf, min_t(loff_t, bufsize, size));
+
+		if (now <= 0) {
+			ret = now ? now : -EIO;
+			break;
+		}
+
+		ret = digest_update(d, buf, now);
+		if (ret)
+			break;
+
+		size -= now;
+
+		if (ctrlc()) {
+			ret = -EINTR;
+			break;
+		}
+	}
+
+	close(fd);
+
+	return ret;
+}
+
+/**
+ * hash the first size bytes of fn and compare them with the reference
+ */
+static int swu_check_ref(struct swu_ref *ref, const char *fn, loff_t size,
+			void *buf, size_t bufsize)
+{
+	unsigned char h[MANIFEST_HASH_SZ];
+	int ret;
+
+	digest_init(ref->d);
+
+	ret = swu_hash_window(fn, ref->d, size, buf, bufsize);
+	if (ret)
+		return ret;
+
+	digest_final(ref->d, h);
+
+	return swu_compare_hash(h, ref->hash, digest_length(ref->d));
+}
+
 /**
  * start image sig check.
- * @param ifn - input file (used to get size for hash calculation and md5 file)
+ * @param ifn - input file (used to get the reference hash and size)
  * @param ofn - output file/device
  * @return 0 on success
  */
 int swu_check_img(const char *ifn, const char *ofn)
 {
-	if (swu_hfile_status(ifn)) {
+	struct swu_ref ref;
+	struct stat st;
+	size_t bufsize;
+	void *buf;
+	int ret;
+
+	ret = swu_get_ref(ifn, &ref);
+	if (ret == -ENOENT) {
 		pr_info("integrity check skipped %s.\n", ifn);
 		return 0;
 	}
-	return swu_check_img_hash(ifn, ofn);
+	if (ret)
+		return ret;
+
+	ret = stat(ifn, &st);
+	if (ret)
+		goto out;
+
+	if (ref.size < 0) {
+		ref.size = st.st_size;
+	} else if (ref.size != st.st_size) {
+		swu_log("ERROR: %s has %lld bytes, expected %lld\n", ifn,
+				st.st_size, ref.size);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	buf = alloc_file_buf(SWU_BUF_SIZE, &bufsize);
+	ret = swu_check_ref(&ref, ofn, ref.size, buf, bufsize);
+	free(buf);
+out:
+	swu_put_ref(&ref);
+
+	return ret;
 }
 
 /**
- * Write sw image to block device
+ * check an image that has been read to memory
+ * @param ifn - file the image has been read from
+ * @param buf - image data
+ * @param len - image size
+ * @return 0 on success
  */
-static int swu_blk_dev_handler(struct bbu_handler *handler,
-				struct bbu_data *data)
+int swu_check_buf(const char *ifn, const void *buf, size_t len)
 {
-	int ret, verbose;
+	unsigned char h[MANIFEST_HASH_SZ];
+	struct swu_ref ref;
+	int ret;
 
-	if (swu_check_limits(data->imagefile, data->devicefile)) {
-		swu_log("ERROR: partition too small or file does not exist\n");
-		return -EINVAL;
+	ret = swu_get_ref(ifn, &ref);
+	if (ret == -ENOENT) {
+		pr_info("integrity check skipped %s.\n", ifn);
+		return 0;
 	}
+	if (ret)
+		return ret;
+
+	if (ref.size >= 0 && ref.size != len) {
+		swu_log("ERROR: %s has %zu bytes, expected %lld\n", ifn, len,
+				ref.size);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = digest_digest(ref.d, buf, len, h);
+	if (!ret)
+		ret = swu_compare_hash(h, ref.hash, digest_length(ref.d));
+out:
+	swu_put_ref(&ref);
+
+	return ret;
+}
+
+/**
+ * copy ifn to ofn and check the copy
+ *
+ * The image is read once: it is hashed while it is written to ofn. The
+ * written data is then read back and checked against the reference hash.
+ * As the image is hashed on the way, a corrupt image is detected only
+ * after it has been written. Images without a reference hash are copied
+ * unchecked.
+ */
+static int swu_copy_checked(const char *ifn, const char *ofn, int oflags,
+			int verbose)
+{
+	unsigned char h[MANIFEST_HASH_SZ];
+	struct swu_ref ref;
+	size_t bufsize;
+	loff_t total;
+	void *buf;
+	int ret;
+
+	ret = swu_get_ref(ifn, &ref);
+	if (ret == -ENOENT) {
+		pr_info("integrity check skipped %s.\n", ifn);
+	} else if (ret) {
+		swu_log("ERROR: cannot read image signature\n");
+		return ret;
+	} else {
+		digest_init(ref.d);
+	}
+
+	buf = alloc_file_buf(SWU_BUF_SIZE, &bufsize);
+
+	ret = swu_copy_hashed(ifn, ofn, oflags, ref.d, buf, bufsize, &total,
+			verbose);
+	if (ret) {
+		swu_log("ERROR: copy failed: %s\n", strerror(-ret));
+		goto out;
+	}
+
+	if (!ref.d)
+		goto out;
+
+	swu_log("running signature check.\n");
+
+	if (ref.size >= 0 && ref.size != total) {
+		swu_log("ERROR: %s has %lld bytes, expected %lld\n", ifn, total,
+				ref.size);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	digest_final(ref.d, h);
+	ret = swu_compare_hash(h, ref.hash, digest_length(ref.d));
+	if (ret) {
+		swu_log("ERROR: image signature check failed!\n");
+		goto out;
+	}
+
+	ret = swu_check_ref(&ref, ofn, total, buf, bufsize);
+	if (ret) {
+		swu_log("ERROR: copy or signature check failed.");
+		ret = -EINVAL;
+	}
+out:
+	free(buf);
+	swu_put_ref(&ref);
+
+	return ret;
+}
+
+/**
+ * Write a sparse image, a delta image or an image with a block map to
+ * block device
+ *
+ * Only the ranges with data are written. The md5sum of the image file is
+ * checked before, the block map checksums are checked while writing. Delta
+ * images check the installed image before and the result after writing.
+ */
+static int swu_blk_dev_write_mapped(struct bbu_data *data,
+				enum filetype type, const char *bmap)
+{
+	unsigned flags = 0;
+	int ret;
 
 	swu_log("running signature check.\n");
 	ret = swu_check_img(data->imagefile, data->imagefile);
@@ -377,19 +1008,67 @@ static int swu_blk_dev_handler(struct bbu_handler *handler,
 		return -EINVAL;
 	}
 
-	swu_log("update block device: S:%s -> D:%s\n",
+	swu_log("update block device (%s): S:%s -> D:%s\n",
+			bmap ? "block map" : file_type_to_short_string(type),
 			data->imagefile,
 			data->devicefile);
 
-	verbose = data->flags & BBU_FLAGS_VERBOSE;
-	ret = copy_file(data->imagefile, data->devicefile, verbose);
-	if (!ret && swu_check_img(data->imagefile, data->devicefile)) {
-		swu_log("ERROR: copy or signature check failed.");
-		ret = -EINVAL;
-	}
+	if (data->flags & BBU_FLAGS_VERBOSE)
+		flags |= IMAGE_WRITE_VERBOSE;
+
+	if (bmap)
+		ret = write_bmap_image(data->imagefile, bmap, data->devicefile,
+				flags);
+	else if (type == filetype_barebox_delta)
+		ret = write_delta_image(data->imagefile, data->devicefile,
+				flags);
+	else
+		ret = write_sparse_image(data->imagefile, data->devicefile,
+				flags);
+	if (ret)
+		swu_log("ERROR: writing image failed: %s\n", strerror(-ret));
+
 	return ret;
 }
 
+/**
+ * Write sw image to block device
+ */
+static int swu_blk_dev_handler(struct bbu_handler *handler,
+				struct bbu_data *data)
+{
+	int ret;
+
+	ret = swu_manifest_check_target(data->imagefile, data->devicefile);
+	if (ret)
+		return ret;
+
+	if (IS_ENABLED(CONFIG_IMAGE_SPARSE)) {
+		char *bmap = image_find_bmap(data->imagefile);
+		enum filetype type = file_name_detect_type(data->imagefile);
+
+		if (bmap || type == filetype_android_sparse ||
+				(IS_ENABLED(CONFIG_IMAGE_DELTA) &&
+				 type == filetype_barebox_delta)) {
+			ret = swu_blk_dev_write_mapped(data, type, bmap);
+			free(bmap);
+			return ret;
+		}
+	}
+
+	if (swu_check_limits(data->imagefile, data->devicefile)) {
+		swu_log("ERROR: partition too small or file does not exist\n");
+		return -EINVAL;
+	}
+
+	swu_log("update block device: S:%s -> D:%s\n",
+			data->imagefile,
+			data->devicefile);
+
+	return swu_copy_checked(data->imagefile, data->devicefile, O_WRONLY,
+			data->flags & BBU_FLAGS_VERBOSE);
+}
+
 static int swu_safe_copy(const char *s, const char *d, int verbose)
 {
 	int ret;
@@ -467,12 +1146,9 @@ static int swu_file_handler(struct bbu_handler *handler,
 {
 	int ret, verbose;
 
-	swu_log("running signature check.\n");
-	ret = swu_check_img(data->imagefile, data->imagefile);
-	if (ret != 0) {
-		swu_log("image signature check failed!\n");
-		return -EINVAL;
-	}
+	ret = swu_manifest_check_target(data->imagefile, data->devicefile);
+	if (ret)
+		return ret;
 
 	swu_log("update file: S:%s -> D:%s\n",
 			data->imagefile,
@@ -499,7 +1175,8 @@ static int swu_file_handler(struct bbu_handler *handler,
 		if(ret)
 			swu_log("Backup old image fails. Continue with updating\n");
 
-		ret = swu_safe_copy(data->imagefile, dst, verbose);
+		ret = swu_copy_checked(data->imagefile, dst,
+				O_WRONLY | O_CREAT | O_TRUNC, verbose);
 
 		free(dst);
 		free(dst_old);
@@ -623,6 +1300,7 @@ static int swu_update_prop_str(struct device_node *root,
 	pp = of_find_property(n, ld->prop, NULL);
 
 	free(pp->value);
+	pp->value_const = NULL;
 
 	pp->value = malloc(len);
 	memcpy(pp->value, v, len);
@@ -656,6 +1334,7 @@ static int swu_update_prop_int(struct device_node *root,
 		return -EINVAL;
 
 	free(pp->value);
+	pp->value_const = NULL;
 
 	val = __cpu_to_be32(tmp);
 	pp->value = malloc(sizeof(val));
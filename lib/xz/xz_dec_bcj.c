@@ -34,9 +34,20 @@ struct xz_dec_bcj {
 	 */
 	enum xz_ret ret;
 
-	/* True if we are operating in single-call mode. */
+	/*
+	 * True if the output buffer is the LZMA2 dictionary (XZ_SINGLE or
+	 * XZ_OUTDICT). The Block can then only be filtered once it has
+	 * been decoded completely, since LZMA2 still refers to the
+	 * unfiltered data.
+	 */
 	bool single_call;
 
+	/*
+	 * Amount of unfiltered data decoded into the output buffer so far.
+	 * It is hidden from the caller until the Block is complete.
+	 */
+	size_t pending;
+
 	/*
 	 * Absolute position relative to the beginning of the uncompressed
 	 * data (in a single .xz Block). We care only about the lowest 32
@@ -420,6 +431,22 @@ XZ_EXTERN enum xz_ret xz_dec_bcj_run(struct xz_dec_bcj *s,
 {
 	size_t out_start;
 
+	if (s->single_call) {
+		out_start = b->out_pos;
+		b->out_pos += s->pending;
+
+		s->ret = xz_dec_lzma2_run(lzma2, b);
+		if (s->ret == XZ_STREAM_END) {
+			bcj_apply(s, b->out, &out_start, b->out_pos);
+			return XZ_STREAM_END;
+		}
+
+		s->pending = b->out_pos - out_start;
+		b->out_pos = out_start;
+
+		return s->ret;
+	}
+
 	/*
 	 * Flush pending already filtered data to the output buffer. Return
 	 * immediatelly if we couldn't flush everything, or if the next
@@ -452,8 +479,7 @@ XZ_EXTERN enum xz_ret xz_dec_bcj_run(struct xz_dec_bcj *s,
 		b->out_pos += s->temp.size;
 
 		s->ret = xz_dec_lzma2_run(lzma2, b);
-		if (s->ret != XZ_STREAM_END
-				&& (s->ret != XZ_OK || s->single_call))
+		if (s->ret != XZ_STREAM_END && s->ret != XZ_OK)
 			return s->ret;
 
 		bcj_apply(s, b->out, &out_start, b->out_pos);
@@ -567,6 +593,7 @@ XZ_EXTERN enum xz_ret xz_dec_bcj_reset(struct xz_dec_bcj *s, uint8_t id)
 	s->x86_prev_mask = 0;
 	s->temp.filtered = 0;
 	s->temp.size = 0;
+	s->pending = 0;
 
 	return XZ_OK;
 }
@@ -1112,7 +1112,11 @@ XZ_EXTERN struct xz_dec_lzma2 *xz_dec_lzma2_create(enum xz_mode mode,
 	if (s == NULL)
 		return NULL;
 
-	s->dict.mode = mode;
+	/*
+	 * With XZ_OUTDICT the dictionary lives in the output buffer,
+	 * which is exactly what the LZMA2 decoder does in single-call mode.
+	 */
+	s->dict.mode = mode == XZ_OUTDICT ? XZ_SINGLE : mode;
 	s->dict.size_max = dict_max;
 
 	if (DEC_IS_PREALLOC(mode)) {
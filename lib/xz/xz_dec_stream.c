@@ -776,7 +776,7 @@ XZ_EXTERN struct xz_dec *xz_dec_init(enum xz_mode mode, uint32_t dict_max)
 	s->mode = mode;
 
 #ifdef XZ_DEC_BCJ
-	s->bcj = xz_dec_bcj_create(DEC_IS_SINGLE(mode));
+	s->bcj = xz_dec_bcj_create(DEC_IS_SINGLE(mode) || mode == XZ_OUTDICT);
 	if (s->bcj == NULL)
 		goto error_bcj;
 #endif
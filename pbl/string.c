@@ -7,35 +7,49 @@
 #include <linux/types.h>
 #include <linux/string.h>
 
+#define WORD_SIZE	sizeof(unsigned long)
+#define WORD_MASK	(WORD_SIZE - 1)
+
+/*
+ * The PBL copies the whole barebox image around before decompressing it,
+ * so copy and fill word-wise whenever the pointers allow it. Only aligned
+ * word accesses are done since the MMU may still be off here.
+ */
 void *memcpy(void *__dest, __const void *__src, size_t __n)
 {
-	int i = 0;
-	unsigned char *d = (unsigned char *)__dest, *s = (unsigned char *)__src;
-
-	for (i = __n >> 3; i > 0; i--) {
-		*d++ = *s++;
-		*d++ = *s++;
-		*d++ = *s++;
-		*d++ = *s++;
-		*d++ = *s++;
-		*d++ = *s++;
-		*d++ = *s++;
-		*d++ = *s++;
-	}
-
-	if (__n & 1 << 2) {
-		*d++ = *s++;
-		*d++ = *s++;
-		*d++ = *s++;
-		*d++ = *s++;
-	}
+	unsigned char *d = __dest;
+	const unsigned char *s = __src;
 
-	if (__n & 1 << 1) {
-		*d++ = *s++;
-		*d++ = *s++;
+	if (__n >= 2 * WORD_SIZE &&
+	    !(((unsigned long)d ^ (unsigned long)s) & WORD_MASK)) {
+		unsigned long *wd;
+		const unsigned long *ws;
+
+		while ((unsigned long)d & WORD_MASK) {
+			*d++ = *s++;
+			__n--;
+		}
+
+		wd = (unsigned long *)d;
+		ws = (const unsigned long *)s;
+
+		for (; __n >= 4 * WORD_SIZE; __n -= 4 * WORD_SIZE) {
+			wd[0] = ws[0];
+			wd[1] = ws[1];
+			wd[2] = ws[2];
+			wd[3] = ws[3];
+			wd += 4;
+			ws += 4;
+		}
+
+		for (; __n >= WORD_SIZE; __n -= WORD_SIZE)
+			*wd++ = *ws++;
+
+		d = (unsigned char *)wd;
+		s = (const unsigned char *)ws;
 	}
 
-	if (__n & 1)
+	while (__n--)
 		*d++ = *s++;
 
 	return __dest;
@@ -43,8 +57,8 @@ void *memcpy(void *__dest, __const void *__src, size_t __n)
 
 void *memmove(void *__dest, __const void *__src, size_t count)
 {
-	unsigned char *d = __dest;
-	const unsigned char *s = __src;
+	unsigned char *d;
+	const unsigned char *s;
 
 	if (__dest == __src)
 		return __dest;
@@ -52,8 +66,32 @@ void *memmove(void *__dest, __const void *__src, size_t count)
 	if (__dest < __src)
 		return memcpy(__dest, __src, count);
 
+	d = (unsigned char *)__dest + count;
+	s = (const unsigned char *)__src + count;
+
+	if (count >= 2 * WORD_SIZE &&
+	    !(((unsigned long)d ^ (unsigned long)s) & WORD_MASK)) {
+		unsigned long *wd;
+		const unsigned long *ws;
+
+		while ((unsigned long)d & WORD_MASK) {
+			*--d = *--s;
+			count--;
+		}
+
+		wd = (unsigned long *)d;
+		ws = (const unsigned long *)s;
+
+		for (; count >= WORD_SIZE; count -= WORD_SIZE)
+			*--wd = *--ws;
+
+		d = (unsigned char *)wd;
+		s = (const unsigned char *)ws;
+	}
+
 	while (count--)
-		d[count] = s[count];
+		*--d = *--s;
+
 	return __dest;
 }
 
@@ -114,9 +152,36 @@ char *_strchr(const char *s, int c)
 
 void *memset(void *s, int c, size_t count)
 {
-	char *xs = s;
+	unsigned char *xs = s;
+
+	if (count >= 2 * WORD_SIZE) {
+		unsigned long pattern = (~0UL / 0xff) * (unsigned char)c;
+		unsigned long *ws;
+
+		while ((unsigned long)xs & WORD_MASK) {
+			*xs++ = c;
+			count--;
+		}
+
+		ws = (unsigned long *)xs;
+
+		for (; count >= 4 * WORD_SIZE; count -= 4 * WORD_SIZE) {
+			ws[0] = pattern;
+			ws[1] = pattern;
+			ws[2] = pattern;
+			ws[3] = pattern;
+			ws += 4;
+		}
+
+		for (; count >= WORD_SIZE; count -= WORD_SIZE)
+			*ws++ = pattern;
+
+		xs = (unsigned char *)ws;
+	}
+
 	while (count--)
 		*xs++ = c;
+
 	return s;
 }
 
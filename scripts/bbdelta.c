@@ -0,0 +1,290 @@
+/*
+ * bbdelta.c - create barebox delta images
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * A delta image contains the blocks in which a new image differs from a
+ * base image, see include/image-sparse.h for the format. barebox applies
+ * it to a device holding the base image.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <endian.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <openssl/evp.h>
+
+#define DELTA_HEADER_MAGIC	0x746c6462
+#define DELTA_HASH_SZ		32
+
+#define CHUNK_TYPE_RAW		0xcac1
+#define CHUNK_TYPE_FILL		0xcac2
+
+struct delta_header {
+	uint32_t magic;
+	uint16_t major_version;
+	uint16_t hdr_sz;
+	uint32_t blk_sz;
+	uint32_t total_chunks;
+	uint64_t base_size;
+	uint64_t image_size;
+	uint8_t base_hash[DELTA_HASH_SZ];
+	uint8_t image_hash[DELTA_HASH_SZ];
+} __attribute__((packed));
+
+struct delta_chunk {
+	uint16_t chunk_type;
+	uint16_t reserved;
+	uint32_t nr_blks;
+	uint64_t blk;
+} __attribute__((packed));
+
+enum blk_class {
+	BLK_SAME,
+	BLK_RAW,
+	BLK_FILL,
+};
+
+struct run {
+	enum blk_class class;
+	uint32_t fill;
+	uint64_t blk;
+	uint32_t nr_blks;
+};
+
+static unsigned int blk_sz = 4096;
+static FILE *out;
+static uint32_t total_chunks;
+static uint64_t image_size;
+static unsigned char *image;
+
+static void *read_image(const char *name, uint64_t *size)
+{
+	struct stat s;
+	void *buf;
+	FILE *f;
+
+	f = fopen(name, "rb");
+	if (!f || fstat(fileno(f), &s)) {
+		perror(name);
+		exit(1);
+	}
+
+	buf = malloc(s.st_size + 1);
+	if (!buf) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	if (fread(buf, 1, s.st_size, f) != s.st_size) {
+		perror(name);
+		exit(1);
+	}
+
+	fclose(f);
+	*size = s.st_size;
+
+	return buf;
+}
+
+static void sha256(const void *buf, size_t len, uint8_t *hash)
+{
+	EVP_MD_CTX *ctx = EVP_MD_CTX_create();
+
+	if (!ctx || !EVP_DigestInit_ex(ctx, EVP_sha256(), NULL) ||
+	    !EVP_DigestUpdate(ctx, buf, len) ||
+	    !EVP_DigestFinal_ex(ctx, hash, NULL)) {
+		fprintf(stderr, "sha256 failed\n");
+		exit(1);
+	}
+
+	EVP_MD_CTX_destroy(ctx);
+}
+
+static void write_out(const void *buf, size_t len)
+{
+	if (fwrite(buf, 1, len, out) != len) {
+		perror("write");
+		exit(1);
+	}
+}
+
+static void flush_run(struct run *r)
+{
+	struct delta_chunk dc;
+	uint64_t offset, len;
+	uint32_t fill;
+
+	if (!r->nr_blks || r->class == BLK_SAME)
+		return;
+
+	memset(&dc, 0, sizeof(dc));
+	dc.chunk_type = htole16(r->class == BLK_RAW ?
+				CHUNK_TYPE_RAW : CHUNK_TYPE_FILL);
+	dc.nr_blks = htole32(r->nr_blks);
+	dc.blk = htole64(r->blk);
+	write_out(&dc, sizeof(dc));
+
+	if (r->class == BLK_RAW) {
+		/* data beyond the end of the image is not stored */
+		offset = r->blk * blk_sz;
+		len = (uint64_t)r->nr_blks * blk_sz;
+		if (offset + len > image_size)
+			len = image_size - offset;
+		write_out(image + offset, len);
+	} else {
+		fill = r->fill;
+		write_out(&fill, sizeof(fill));
+	}
+
+	total_chunks++;
+}
+
+static enum blk_class classify(const unsigned char *base, uint64_t base_size,
+			       uint64_t blk, uint32_t *fill)
+{
+	uint64_t offset = blk * blk_sz;
+	uint64_t len = blk_sz;
+	uint32_t v;
+	uint64_t i;
+
+	if (offset + len > image_size)
+		len = image_size - offset;
+
+	if (offset + len <= base_size && !memcmp(base + offset,
+						 image + offset, len))
+		return BLK_SAME;
+
+	if (len != blk_sz)
+		return BLK_RAW;
+
+	memcpy(&v, image + offset, sizeof(v));
+	for (i = 0; i < len; i += sizeof(v))
+		if (memcmp(&v, image + offset + i, sizeof(v)))
+			return BLK_RAW;
+
+	*fill = v;
+
+	return BLK_FILL;
+}
+
+static void usage(const char *prgname)
+{
+	fprintf(stderr,
+		"usage: %s [OPTIONS] <base> <image> <delta>\n"
+		"Create a delta image which updates <base> to <image>\n"
+		"\n"
+		"options:\n"
+		"  -b <size>  block size, default 4096\n",
+		prgname);
+}
+
+int main(int argc, char *argv[])
+{
+	struct delta_header dh;
+	struct run r = { .class = BLK_SAME };
+	unsigned char *base;
+	uint64_t base_size, blk, nr_blks, changed = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:h")) != -1) {
+		switch (opt) {
+		case 'b':
+			blk_sz = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+			usage(argv[0]);
+			exit(0);
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (argc - optind != 3) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	if (!blk_sz || blk_sz % 4) {
+		fprintf(stderr, "invalid block size %u\n", blk_sz);
+		exit(1);
+	}
+
+	base = read_image(argv[optind], &base_size);
+	image = read_image(argv[optind + 1], &image_size);
+
+	out = fopen(argv[optind + 2], "wb");
+	if (!out) {
+		perror(argv[optind + 2]);
+		exit(1);
+	}
+
+	memset(&dh, 0, sizeof(dh));
+	write_out(&dh, sizeof(dh));
+
+	nr_blks = (image_size + blk_sz - 1) / blk_sz;
+
+	for (blk = 0; blk < nr_blks; blk++) {
+		uint32_t fill = 0;
+		enum blk_class class = classify(base, base_size, blk, &fill);
+
+		if (class != BLK_SAME)
+			changed++;
+
+		if (class == r.class && (class != BLK_FILL || fill == r.fill) &&
+		    r.nr_blks < UINT32_MAX) {
+			r.nr_blks++;
+			continue;
+		}
+
+		flush_run(&r);
+
+		r.class = class;
+		r.fill = fill;
+		r.blk = blk;
+		r.nr_blks = 1;
+	}
+
+	flush_run(&r);
+
+	dh.magic = htole32(DELTA_HEADER_MAGIC);
+	dh.major_version = htole16(1);
+	dh.hdr_sz = htole16(sizeof(dh));
+	dh.blk_sz = htole32(blk_sz);
+	dh.total_chunks = htole32(total_chunks);
+	dh.base_size = htole64(base_size);
+	dh.image_size = htole64(image_size);
+	sha256(base, base_size, dh.base_hash);
+	sha256(image, image_size, dh.image_hash);
+
+	if (fseek(out, 0, SEEK_SET)) {
+		perror("seek");
+		exit(1);
+	}
+
+	write_out(&dh, sizeof(dh));
+
+	if (fclose(out)) {
+		perror(argv[optind + 2]);
+		exit(1);
+	}
+
+	printf("%llu of %llu blocks changed, %u chunks\n",
+	       (unsigned long long)changed, (unsigned long long)nr_blks,
+	       total_chunks);
+
+	return 0;
+}